@@ -3,16 +3,28 @@
 #if PLATFORM_GDK
 
 #include "OnlinePlatformXboxLive.h"
+#include "OnlinePlatformXboxLiveTrace.h"
+#include "XboxLiveAllocator.h"
+#include "XboxLiveService.h"
 #include "Engine/Core/Log.h"
+#include "Engine/Core/Math/Math.h"
+#include "Engine/Core/Random.h"
+#include "Engine/Core/Memory/Memory.h"
 #include "Engine/Core/Types/TimeSpan.h"
 #include "Engine/Core/Collections/Array.h"
 #include "Engine/Core/Config/PlatformSettings.h"
 #include "Engine/Engine/Engine.h"
 #include "Engine/Profiler/ProfilerCPU.h"
 #include "Engine/Platform/User.h"
+#include "Engine/Platform/Thread.h"
+#include "Engine/Platform/CriticalSection.h"
+#include "Engine/Threading/Threading.h"
+#include "Engine/Threading/IRunnable.h"
+#include "Engine/Threading/ConcurrentQueue.h"
 #include "Engine/Platform/Win32/IncludeWindowsHeaders.h"
 #include <XGameRuntime.h>
 #include <xsapi-c/services_c.h>
+#include <stdlib.h>
 
 #define XBOX_LIVE_LOG(method) \
         if (FAILED(result)) \
@@ -31,17 +43,77 @@
         }
 
 #define XBOX_LIVE_SAVE_GAME_BLOB_NAME "data"
+#define XBOX_LIVE_LEADERBOARD_CACHE_MAX_ROWS 10000
+#define XBOX_LIVE_PROFILE_CACHE_TTL 300.0
+#define XBOX_LIVE_CANCEL_TIMEOUT 1.0
+#define XBOX_LIVE_CLEANUP_TIMEOUT 5.0
 
 void* XblMemAlloc(size_t size, HCMemoryType memoryType)
 {
-    return Allocator::Allocate(size);
+    return XboxLiveAllocator::Allocate(size, (uint32)memoryType);
 }
 
 void XblMemFree(void* pointer, HCMemoryType memoryType)
 {
-    Allocator::Free(pointer);
+    XboxLiveAllocator::Free(pointer);
 }
 
+const XboxLiveService& XboxLiveService::GetDefault()
+{
+    static XboxLiveService service = []
+    {
+        XboxLiveService s;
+        s.Initialize = [](const XblInitArgs* args)
+        {
+            XblMemSetFunctions(XblMemAlloc, XblMemFree);
+            return XblInitialize(args);
+        };
+        s.CleanupAsync = [](XAsyncBlock* async) { return XblCleanupAsync(async); };
+        s.GetScid = [](const char** scid) { return XblGetScid(scid); };
+        s.UserGetLocalId = [](XUserHandle user, XUserLocalId* userLocalId) { return XUserGetLocalId(user, userLocalId); };
+        s.UserGetGamertag = [](XUserHandle user, XUserGamertagComponent gamertagComponent, size_t gamertagSize, char* gamertag, size_t* gamertagUsed) { return XUserGetGamertag(user, gamertagComponent, gamertagSize, gamertag, gamertagUsed); };
+        s.UserRegisterForChangeEvent = [](XTaskQueueHandle queue, void* context, XUserChangeEventCallback* callback, XTaskQueueRegistrationToken* token) { return XUserRegisterForChangeEvent(queue, context, callback, token); };
+        s.ContextCreateHandle = [](XUserHandle user, XblContextHandle* context) { return XblContextCreateHandle(user, context); };
+        s.ContextDuplicateHandle = [](XblContextHandle context, XblContextHandle* duplicatedHandle) { return XblContextDuplicateHandle(context, duplicatedHandle); };
+        s.ContextCloseHandle = [](XblContextHandle context) { XblContextCloseHandle(context); };
+        s.ContextGetXboxUserId = [](XblContextHandle context, uint64_t* xboxUserId) { return XblContextGetXboxUserId(context, xboxUserId); };
+        s.SocialGetSocialRelationshipsAsync = [](XblContextHandle context, uint64_t xboxUserId, XblSocialRelationshipFilter filter, size_t startIndex, size_t maxItems, XAsyncBlock* async) { return XblSocialGetSocialRelationshipsAsync(context, xboxUserId, filter, startIndex, maxItems, async); };
+        s.SocialGetSocialRelationshipsResult = [](XAsyncBlock* async, XblSocialRelationshipResultHandle* handle) { return XblSocialGetSocialRelationshipsResult(async, handle); };
+        s.SocialRelationshipResultGetRelationships = [](XblSocialRelationshipResultHandle handle, const XblSocialRelationship** relationships, size_t* relationshipsCount) { return XblSocialRelationshipResultGetRelationships(handle, relationships, relationshipsCount); };
+        s.SocialRelationshipResultHasNext = [](XblSocialRelationshipResultHandle handle, bool* hasNext) { return XblSocialRelationshipResultHasNext(handle, hasNext); };
+        s.SocialRelationshipResultGetNextAsync = [](XblContextHandle context, XblSocialRelationshipResultHandle handle, size_t maxItems, XAsyncBlock* async) { return XblSocialRelationshipResultGetNextAsync(context, handle, maxItems, async); };
+        s.SocialRelationshipResultGetNextResult = [](XAsyncBlock* async, XblSocialRelationshipResultHandle* handle) { return XblSocialRelationshipResultGetNextResult(async, handle); };
+        s.SocialRelationshipResultCloseHandle = [](XblSocialRelationshipResultHandle handle) { XblSocialRelationshipResultCloseHandle(handle); };
+        s.ProfileGetUserProfilesAsync = [](XblContextHandle context, const uint64_t* xboxUserIds, size_t xboxUserIdsCount, XAsyncBlock* async) { return XblProfileGetUserProfilesAsync(context, xboxUserIds, xboxUserIdsCount, async); };
+        s.ProfileGetUserProfilesResultCount = [](XAsyncBlock* async, size_t* profileCount) { return XblProfileGetUserProfilesResultCount(async, profileCount); };
+        s.ProfileGetUserProfilesResult = [](XAsyncBlock* async, size_t profilesCount, XblUserProfile* profiles) { return XblProfileGetUserProfilesResult(async, profilesCount, profiles); };
+        s.LeaderboardGetLeaderboardAsync = [](XblContextHandle context, XblLeaderboardQuery query, XAsyncBlock* async) { return XblLeaderboardGetLeaderboardAsync(context, query, async); };
+        s.LeaderboardGetLeaderboardResultSize = [](XAsyncBlock* async, size_t* resultSizeInBytes) { return XblLeaderboardGetLeaderboardResultSize(async, resultSizeInBytes); };
+        s.LeaderboardGetLeaderboardResult = [](XAsyncBlock* async, size_t bufferSize, void* buffer, XblLeaderboardResult** ptrToBuffer, size_t* bufferUsed) { return XblLeaderboardGetLeaderboardResult(async, bufferSize, buffer, ptrToBuffer, bufferUsed); };
+        s.GameSaveInitializeProviderAsync = [](XUserHandle user, const char* configurationId, bool syncOnDemand, XAsyncBlock* async) { return XGameSaveInitializeProviderAsync(user, configurationId, syncOnDemand, async); };
+        s.GameSaveInitializeProviderResult = [](XAsyncBlock* async, XGameSaveProviderHandle* provider) { return XGameSaveInitializeProviderResult(async, provider); };
+        s.GameSaveCloseProvider = [](XGameSaveProviderHandle provider) { XGameSaveCloseProvider(provider); };
+        s.GameSaveGetContainerInfo = [](XGameSaveProviderHandle provider, const char* containerName, void* context, XGameSaveContainerInfoCallback* callback) { return XGameSaveGetContainerInfo(provider, containerName, context, callback); };
+        s.GameSaveCreateContainer = [](XGameSaveProviderHandle provider, const char* containerName, XGameSaveContainerHandle* container) { return XGameSaveCreateContainer(provider, containerName, container); };
+        s.GameSaveCloseContainer = [](XGameSaveContainerHandle container) { XGameSaveCloseContainer(container); };
+        s.GameSaveEnumerateBlobInfo = [](XGameSaveContainerHandle container, void* context, XGameSaveBlobInfoCallback* callback) { return XGameSaveEnumerateBlobInfo(container, context, callback); };
+        s.GameSaveReadBlobData = [](XGameSaveContainerHandle container, const char** blobNames, uint32_t* countOfBlobs, size_t blobsSize, XGameSaveBlob* blobData) { return XGameSaveReadBlobData(container, blobNames, countOfBlobs, blobsSize, blobData); };
+        s.GameSaveCreateUpdate = [](XGameSaveContainerHandle container, const char* containerDisplayName, XGameSaveUpdateHandle* update) { return XGameSaveCreateUpdate(container, containerDisplayName, update); };
+        s.GameSaveCloseUpdate = [](XGameSaveUpdateHandle update) { XGameSaveCloseUpdate(update); };
+        s.GameSaveSubmitBlobWrite = [](XGameSaveUpdateHandle update, const char* blobName, const uint8_t* data, size_t byteCount) { return XGameSaveSubmitBlobWrite(update, blobName, data, byteCount); };
+        s.GameSaveSubmitBlobDelete = [](XGameSaveUpdateHandle update, const char* blobName) { return XGameSaveSubmitBlobDelete(update, blobName); };
+        s.GameSaveSubmitUpdate = [](XGameSaveUpdateHandle update) { return XGameSaveSubmitUpdate(update); };
+        return s;
+    }();
+    return service;
+}
+
+// The functions used for the service requests (see OnlinePlatformXboxLive::Service)
+const XboxLiveService* Backend = &XboxLiveService::GetDefault();
+
+// The initialized platform (SDK, task queue callbacks and caches are process-wide so only a single one can be used at once)
+OnlinePlatformXboxLive* ActivePlatform = nullptr;
+
 Guid GetUserId(uint64_t xboxUserId)
 {
     // Xbox Live uses 64 bits, Guid is 128 bits
@@ -55,68 +127,1087 @@ uint64_t GetXboxUserId(const Guid& id)
     return *(uint64*)&id;
 }
 
+// Result of the background task passed to the main thread (see OnlinePlatformXboxLive::ProcessCompletions)
+struct XblCompletion
+{
+    enum class Types
+    {
+        LeaderboardPrefetch,
+        StatsUpdate,
+        AchievementUpdate,
+        SaveProviderInit,
+        PresenceUpdate,
+        PresenceChange,
+        PresenceLeft,
+        PresenceQuery,
+        UserChange,
+    };
+
+    Types Type;
+    void* Context;
+    uint64 XboxUserId;
+    OnlinePresenceStates Presence;
+    uint64 UserLocalId;
+    XUserChangeEvent UserChange;
+};
+
+// Lock-free queue with completions produced by the thread that dispatches the task queue callbacks and consumed by the main thread
+struct XblCompletionQueue : ConcurrentQueue<XblCompletion>
+{
+    // The title identifier (presence handlers use the queue as their context so they don't reference the subscription deleted on the main thread)
+    uint32 TitleId = 0;
+
+    void Add(XblCompletion::Types type, void* context)
+    {
+        XblCompletion completion;
+        completion.Type = type;
+        completion.Context = context;
+        completion.XboxUserId = 0;
+        completion.Presence = OnlinePresenceStates::Offline;
+        completion.UserLocalId = 0;
+        completion.UserChange = XUserChangeEvent::Privileges;
+        ConcurrentQueue<XblCompletion>::Add(completion);
+    }
+
+    void AddPresence(uint64 xboxUserId, OnlinePresenceStates state, XblCompletion::Types type = XblCompletion::Types::PresenceChange)
+    {
+        XblCompletion completion;
+        completion.Type = type;
+        completion.Context = nullptr;
+        completion.XboxUserId = xboxUserId;
+        completion.Presence = state;
+        completion.UserLocalId = 0;
+        completion.UserChange = XUserChangeEvent::Privileges;
+        ConcurrentQueue<XblCompletion>::Add(completion);
+    }
+};
+
+// Amount of callbacks submitted to the task queue completion port but not yet dispatched (see XboxLiveDispatchStats::Backlog)
+volatile int64 QueuedCallbacks = 0;
+
+void CALLBACK OnTaskQueueSubmit(_In_opt_ void* context, _In_ XTaskQueueHandle queue, _In_ XTaskQueuePort port)
+{
+    if (port == XTaskQueuePort::Completion)
+        Platform::InterlockedIncrement(&QueuedCallbacks);
+}
+
+// Dispatches a single callback from the task queue completion port
+bool XblDispatch(XTaskQueueHandle queue, uint32 timeout = 0)
+{
+    if (!XTaskQueueDispatch(queue, XTaskQueuePort::Completion, timeout))
+        return false;
+    Platform::InterlockedDecrement(&QueuedCallbacks);
+    return true;
+}
+
+// Thread that dispatches the task queue callbacks (see OnlinePlatformXboxLive::UseWorkerThread)
+class XblWorker : public IRunnable
+{
+public:
+    XTaskQueueHandle Queue = nullptr;
+    volatile int64 ExitFlag = 0;
+    Thread* WorkerThread = nullptr;
+
+    // [IRunnable]
+    String ToString() const override
+    {
+        return TEXT("Xbox Live");
+    }
+
+    int32 Run() override
+    {
+        while (Platform::AtomicRead(&ExitFlag) == 0)
+            XblDispatch(Queue, 10);
+        return 0;
+    }
+
+    void Stop() override
+    {
+        Platform::AtomicStore(&ExitFlag, 1);
+    }
+};
+
+XblWorker* Worker = nullptr;
+
+// Process-wide cache of user profiles (shared by local users, friends and leaderboards) with LRU eviction
+struct XblProfileCache
+{
+    struct Entry
+    {
+        uint64 XboxUserId;
+        String Name;
+        StringAnsi Gamertag;
+        String AvatarUrl;
+        double ProfileTime = 0.0;
+        int32 MemoryUsage = 0;
+        Entry* Prev = nullptr;
+        Entry* Next = nullptr;
+    };
+
+    // Cache is used by the main thread and the worker thread (results marshalling)
+    CriticalSection Locker;
+    Dictionary<uint64, Entry*> Lookup;
+    Entry* First = nullptr;
+    Entry* Last = nullptr;
+    int64 MemoryUsage = 0;
+    int64 MemoryBudget = 1024 * 1024;
+
+    ~XblProfileCache()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        ScopeLock lock(Locker);
+        Lookup.ClearDelete();
+        First = Last = nullptr;
+        MemoryUsage = 0;
+    }
+
+    // Gets the user name if the profile was fully fetched from the service within the given time.
+    bool TryGetName(uint64 xboxUserId, double minTime, String& name)
+    {
+        ScopeLock lock(Locker);
+        Entry* e = Get(xboxUserId);
+        if (e && e->ProfileTime > 0.0 && e->ProfileTime >= minTime)
+        {
+            name = e->Name;
+            return true;
+        }
+        return false;
+    }
+
+    bool TryGetAvatarUrl(uint64 xboxUserId, String& url)
+    {
+        ScopeLock lock(Locker);
+        Entry* e = Get(xboxUserId);
+        if (e && e->AvatarUrl.HasChars())
+        {
+            url = e->AvatarUrl;
+            return true;
+        }
+        return false;
+    }
+
+    // Adds or updates the user profile (gamertag conversion is skipped if it didn't change) and outputs the user name.
+    void Set(uint64 xboxUserId, const char* gamertag, String& name, const char* avatarUrl = nullptr, double profileTime = 0.0)
+    {
+        ScopeLock lock(Locker);
+        Entry* e = Get(xboxUserId);
+        if (!e)
+        {
+            e = New<Entry>();
+            e->XboxUserId = xboxUserId;
+            Lookup.Add(xboxUserId, e);
+            Link(e);
+        }
+        const int32 gamertagLength = StringUtils::Length(gamertag);
+        if (e->Gamertag.Length() != gamertagLength || StringUtils::Compare(e->Gamertag.Get(), gamertag) != 0)
+        {
+            e->Gamertag.Set(gamertag, gamertagLength);
+            e->Name.SetUTF8(gamertag, gamertagLength);
+        }
+        if (avatarUrl && !EqualsASCII(e->AvatarUrl, avatarUrl))
+            e->AvatarUrl.SetUTF8(avatarUrl, StringUtils::Length(avatarUrl));
+        if (profileTime > 0.0)
+            e->ProfileTime = profileTime;
+
+        // Update memory usage and evict the least recently used profiles
+        MemoryUsage -= e->MemoryUsage;
+        e->MemoryUsage = sizeof(Entry) + sizeof(uint64) + sizeof(void*) + (e->Name.Length() + e->AvatarUrl.Length() + 2) * sizeof(Char) + e->Gamertag.Length() + 1;
+        MemoryUsage += e->MemoryUsage;
+        while (MemoryUsage > MemoryBudget && Last != e)
+            Remove(Last->XboxUserId);
+        name = e->Name;
+    }
+
+    void Remove(uint64 xboxUserId)
+    {
+        ScopeLock lock(Locker);
+        Entry* e;
+        if (Lookup.TryGet(xboxUserId, e))
+        {
+            Unlink(e);
+            Lookup.Remove(xboxUserId);
+            MemoryUsage -= e->MemoryUsage;
+            Delete(e);
+        }
+    }
+
+private:
+    // Gets the user profile and marks it as the most recently used one.
+    Entry* Get(uint64 xboxUserId)
+    {
+        Entry* e;
+        if (!Lookup.TryGet(xboxUserId, e))
+            return nullptr;
+        Unlink(e);
+        Link(e);
+        return e;
+    }
+
+    static bool EqualsASCII(const String& a, const char* b)
+    {
+        const Char* aPtr = a.Get();
+        const int32 length = a.Length();
+        for (int32 i = 0; i < length; i++)
+        {
+            if (b[i] == 0 || aPtr[i] != (Char)b[i])
+                return false;
+        }
+        return b[length] == 0;
+    }
+
+    void Link(Entry* e)
+    {
+        e->Prev = nullptr;
+        e->Next = First;
+        if (First)
+            First->Prev = e;
+        First = e;
+        if (!Last)
+            Last = e;
+    }
+
+    void Unlink(Entry* e)
+    {
+        if (e->Prev)
+            e->Prev->Next = e->Next;
+        else
+            First = e->Next;
+        if (e->Next)
+            e->Next->Prev = e->Prev;
+        else
+            Last = e->Prev;
+        e->Prev = e->Next = nullptr;
+    }
+};
+
+XblProfileCache ProfileCache;
+
+// Reusable memory for unpacking the async results (per thread as callbacks are dispatched on the main thread, worker thread or inside XblSyncWait)
+struct XblScratch
+{
+    // Total amount of the buffers reallocations (on all threads)
+    static volatile int64 Allocations;
+
+    Array<byte> Buffer;
+    Array<XblUserProfile> Profiles;
+    Array<XblPresenceRecordHandle> PresenceRecords;
+    Array<OnlineLeaderboardEntry> Entries;
+    Array<uint64_t> FriendsIds;
+    Array<uint64_t> ProfilesIds;
+    Dictionary<uint64, int32> ProfilesLookup;
+
+    template<typename T>
+    T* Get(Array<T>& array, int32 count)
+    {
+        // Array capacity grows geometrically and it's never shrunk
+        if (count > array.Capacity())
+            Platform::InterlockedIncrement(&Allocations);
+        array.Resize(count, false);
+        return array.Get();
+    }
+
+    void* GetBuffer(size_t size)
+    {
+        return Get(Buffer, (int32)size);
+    }
+};
+
+volatile int64 XblScratch::Allocations = 0;
+thread_local XblScratch Scratch;
+
+// Async task in flight that can be canceled (see OnlinePlatformXboxLive::CancelOperations)
+struct XblOperation
+{
+    User* LocalUser = nullptr;
+    // The running task (null if not started)
+    XAsyncBlock* Async = nullptr;
+    bool Canceled = false;
+    // The time when the operation was started (used by the trace)
+    double StartTime = 0.0;
+};
+
+CriticalSection OperationsLocker;
+Array<XblOperation*> Operations;
+
+// Registers the started task (cancels it immediately if the operation was canceled before)
+void XblTrackOperation(XblOperation& operation, XAsyncBlock* ab)
+{
+    ScopeLock lock(OperationsLocker);
+    if (!operation.Async)
+    {
+        Operations.Add(&operation);
+        operation.StartTime = Platform::GetTimeSeconds();
+    }
+    operation.Async = ab;
+    if (operation.Canceled)
+        XAsyncCancel(ab);
+}
+
+// Unregisters the operation (once its task has ended)
+void XblUntrackOperation(XblOperation& operation)
+{
+    ScopeLock lock(OperationsLocker);
+    operation.Async = nullptr;
+    Operations.Remove(&operation);
+}
+
+bool XblIsCanceled(const XblOperation& operation)
+{
+    ScopeLock lock(OperationsLocker);
+    return operation.Canceled;
+}
+
+// Gets the amount of the requests in flight of the local user (or all users if null)
+int32 XblCountOperations(User* localUser)
+{
+    ScopeLock lock(OperationsLocker);
+    int32 count = 0;
+    for (const XblOperation* operation : Operations)
+    {
+        if (!localUser || operation->LocalUser == localUser)
+            count++;
+    }
+    return count;
+}
+
+// State of the async task shared between the callback (on any thread that dispatches the task queue) and the waiting thread
 struct XblSyncContext
 {
-    bool Active = true;
-    bool Failed = true;
+    volatile int64 Active = 1;
+    volatile int64 Failed = 1;
+    XblOperation Operation;
+    // The completion times of the result pages (captured only while recording the trace)
+    Array<double> PageTimes;
+
+    void Begin()
+    {
+        PageTimes.Clear();
+        Platform::AtomicStore(&Failed, 1);
+        Platform::AtomicStore(&Active, 1);
+    }
+
+    void AddPage()
+    {
+        if (OnlinePlatformXboxLiveTrace::IsRecording())
+            PageTimes.Add(Platform::GetTimeSeconds());
+    }
+
+    void Finish(bool failed)
+    {
+        // Result has to be visible before the waiting thread sees the task deactivated
+        Platform::AtomicStore(&Failed, failed ? 1 : 0);
+        Platform::AtomicStore(&Active, 0);
+    }
+
+    bool IsActive()
+    {
+        return Platform::AtomicRead(&Active) != 0;
+    }
+
+    bool IsFailed()
+    {
+        return Platform::AtomicRead(&Failed) != 0;
+    }
 };
 
 struct XblAchievementsContext : XblSyncContext
 {
+    XblContextHandle Context;
+    uint64 XboxUserId;
+    uint32 TitleId = 0;
     Array<OnlineAchievement>* Achievements;
     int32 Iteration = 0;
+    // The last fetched page (query is resumed from it if the next page fails)
+    XblAchievementsResultHandle Page = nullptr;
+
+    ~XblAchievementsContext()
+    {
+        if (Page)
+            XblAchievementsResultCloseHandle(Page);
+    }
+
+    HRESULT Start(XAsyncBlock* ab)
+    {
+        if (Page)
+        {
+            Iteration = Math::Max(Iteration, 1);
+            return XblAchievementsResultGetNextAsync(Page, 1, ab);
+        }
+        return XblAchievementsGetAchievementsForTitleIdAsync(Context, XboxUserId, TitleId, XblAchievementType::All, false, XblAchievementOrderBy::DefaultOrder, 0, 0, ab);
+    }
+};
+
+struct XblStatsContext : XblSyncContext
+{
+    bool Exists = false;
+    XboxLiveStatValue Value;
+};
+
+struct XblTitleAchievementsContext : XblAchievementsContext
+{
+    XAsyncBlock Async = {};
+    HRESULT Result = E_PENDING;
+    Array<OnlineAchievement> Results;
+};
+
+struct XblServiceStatsContext : XblSyncContext
+{
+    XAsyncBlock Async = {};
+    HRESULT Result = E_PENDING;
+    XblContextHandle Context;
+    uint64 XboxUserId;
+    String Scid;
+    const char** Names;
+    int32 NamesCount;
+    Array<XboxLiveServiceStat> Results;
+
+    HRESULT Start(XAsyncBlock* ab)
+    {
+        const StringAsANSI<> scidStr(Scid.Get(), Scid.Length());
+        return XblUserStatisticsGetMultipleUserStatisticsAsync(Context, &XboxUserId, 1, scidStr.Get(), Names, NamesCount, ab);
+    }
+};
+
+struct XblPendingStat
+{
+    StringAnsi Name;
+    double Value;
+};
+
+struct XblUserStats
+{
+    // Stats waiting to be sent in the next batch
+    Array<XblPendingStat> Pending;
+    // Best submitted score for each leaderboard (for keepBest), removed when its submission fails so it's read from the service again
+    Dictionary<StringAnsi, int32> BestScores;
+
+    void SetStat(const StringAnsiView& name, double value)
+    {
+        for (XblPendingStat& e : Pending)
+        {
+            if (e.Name == name)
+            {
+                e.Value = value;
+                return;
+            }
+        }
+        auto& e = Pending.AddOne();
+        e.Name = name;
+        e.Value = value;
+    }
+
+    // Restores the stats of the failed update, stats that failed due to a temporary problem are sent again with the next flush (unless they were updated meanwhile)
+    void Restore(const Array<XblPendingStat>& stats, bool retry)
+    {
+        for (const XblPendingStat& e : stats)
+        {
+            bool pending = false;
+            for (const XblPendingStat& p : Pending)
+                pending |= p.Name == e.Name;
+            if (pending)
+                continue;
+            if (retry)
+                Pending.Add(e);
+            else
+                BestScores.Remove(e.Name);
+        }
+    }
+};
+
+struct XblStatsUpdateContext
+{
+    XAsyncBlock Async = {};
+    XblOperation Operation;
+    User* LocalUser;
+    XblContextHandle Context;
+    Array<XblPendingStat> Stats;
+    Array<XblTitleManagedStatistic> Statistics;
+    XblCompletionQueue* Completions = nullptr;
+};
+
+struct XblAchievementUpdateContext
+{
+    XAsyncBlock Async = {};
+    XblOperation Operation;
+    XblCompletionQueue* Completions = nullptr;
+};
+
+struct XblSaveProviderContext
+{
+    XAsyncBlock Async = {};
+    XblOperation Operation;
+    XblCompletionQueue* Completions = nullptr;
+};
+
+struct XblRichPresence
+{
+    bool Active = true;
+    StringAnsi Id;
+    Array<StringAnsi> Tokens;
+
+    bool operator==(const XblRichPresence& other) const
+    {
+        return Active == other.Active && Id == other.Id && Tokens == other.Tokens;
+    }
+
+    bool operator!=(const XblRichPresence& other) const
+    {
+        return !operator==(other);
+    }
+};
+
+// Rich presence of the local user (set by the game and sent in the background)
+struct XblUserPresence
+{
+    // The latest presence set by the game
+    XblRichPresence Current;
+    // The last presence accepted by the service
+    XblRichPresence Sent;
+    bool HasSent = false;
+    bool Sending = false;
+    double SendTime = 0.0;
+};
+
+struct XblPresenceUpdateContext
+{
+    XAsyncBlock Async = {};
+    XblOperation Operation;
+    XblContextHandle Context;
+    XblRichPresence Presence;
+    Array<const char*> Tokens;
+    XblPresenceRichPresenceIds Ids = {};
+    XblCompletionQueue* Completions = nullptr;
+};
+
+struct XblPresenceContext : XblSyncContext
+{
+    OnlinePresenceStates Presence;
+};
+
+struct XblPresenceUsersContext : XblSyncContext
+{
+    Dictionary<uint64, OnlinePresenceStates>* Presence;
+};
+
+// Presence request sent in the background when the tracked user left the device or the title (user can be still online on the other one) or when the subscription was recreated
+struct XblPresenceQueryContext
+{
+    XAsyncBlock Async = {};
+    XblOperation Operation;
+    XblContextHandle Context = nullptr;
+    Array<uint64> Users;
+    XblCompletionQueue* Completions = nullptr;
+};
+
+struct XblPresenceSubscription
+{
+    XblContextHandle Context;
+    XblFunctionContext DeviceHandler;
+    XblFunctionContext TitleHandler;
+    Array<uint64> Users;
+};
+
+struct XblFriendsContext : XblSyncContext
+{
+    XblContextHandle Context;
+    uint64 XboxUserId;
+    Array<uint64_t> FriendsIds;
+    Array<uint64_t> ProfilesIds;
+    Dictionary<uint64, int32> ProfilesLookup;
+    Array<OnlineUser>* Friends;
+    int32 Iteration = 0;
+    // The last fetched page (query is resumed from it if the next page fails)
+    XblSocialRelationshipResultHandle Page = nullptr;
+
+    XblFriendsContext()
+    {
+        // Borrow the lists memory from the calling thread
+        FriendsIds.Swap(Scratch.FriendsIds);
+        ProfilesIds.Swap(Scratch.ProfilesIds);
+        ProfilesLookup.Swap(Scratch.ProfilesLookup);
+    }
+
+    ~XblFriendsContext()
+    {
+        if (Page)
+            Backend->SocialRelationshipResultCloseHandle(Page);
+        FriendsIds.Clear();
+        ProfilesIds.Clear();
+        ProfilesLookup.Clear();
+        FriendsIds.Swap(Scratch.FriendsIds);
+        ProfilesIds.Swap(Scratch.ProfilesIds);
+        ProfilesLookup.Swap(Scratch.ProfilesLookup);
+    }
+
+    HRESULT Start(XAsyncBlock* ab)
+    {
+        if (Page)
+        {
+            Iteration = Math::Max(Iteration, 1);
+            return Backend->SocialRelationshipResultGetNextAsync(Context, Page, 0, ab);
+        }
+        return Backend->SocialGetSocialRelationshipsAsync(Context, XboxUserId, XblSocialRelationshipFilter::All, 0, 0, ab);
+    }
+};
+
+// Leaderboard rows cached by position (in rank order) using structure-of-arrays layout
+struct XblLeaderboardCache
+{
+    int32 TotalCount = -1;
+    int32 PrefetchStart = -1;
+    Array<double> Times;
+    Array<int32> Ranks;
+    Array<int32> Scores;
+    Array<uint64> UserIds;
+    Array<int32> GamerTags;
+
+    // Interned gamertags (indexed by GamerTags, slots without rows referencing them are reused)
+    Array<String> GamerTagsNames;
+    Array<int32> GamerTagsRefs;
+    Array<int32> GamerTagsFree;
+    Dictionary<uint64, int32> GamerTagsLookup;
+
+    void Clear()
+    {
+        TotalCount = -1;
+        Times.Clear();
+        Ranks.Clear();
+        Scores.Clear();
+        UserIds.Clear();
+        GamerTags.Clear();
+        GamerTagsNames.Clear();
+        GamerTagsRefs.Clear();
+        GamerTagsFree.Clear();
+        GamerTagsLookup.Clear();
+    }
+
+    // Updates the interned gamertag of the user (eg. after the user changed it)
+    void SetGamerTag(uint64 xboxUserId, const String& name)
+    {
+        int32 gamerTag;
+        if (GamerTagsLookup.TryGet(xboxUserId, gamerTag) && GamerTagsNames[gamerTag] != name)
+            GamerTagsNames[gamerTag] = name;
+    }
+
+    void EnsureRows(int32 count)
+    {
+        const int32 start = Times.Count();
+        if (count <= start)
+            return;
+        Times.Resize(count);
+        Ranks.Resize(count);
+        Scores.Resize(count);
+        UserIds.Resize(count);
+        GamerTags.Resize(count);
+        for (int32 i = start; i < count; i++)
+        {
+            Times[i] = 0.0;
+            UserIds[i] = 0;
+            GamerTags[i] = -1;
+        }
+    }
+
+    bool HasRows(int32 start, int32 count, double minTime) const
+    {
+        int32 end = start + count;
+        if (TotalCount >= 0 && end > TotalCount)
+            end = TotalCount;
+        if (end > Times.Count())
+            return false;
+        for (int32 i = start; i < end; i++)
+        {
+            if (Times[i] < minTime || Times[i] <= 0.0)
+                return false;
+        }
+        return true;
+    }
+
+    void GetRows(int32 start, int32 count, Array<OnlineLeaderboardEntry>& entries) const
+    {
+        int32 end = start + count;
+        if (TotalCount >= 0 && end > TotalCount)
+            end = TotalCount;
+        entries.Resize(Math::Max(end - start, 0));
+        for (int32 i = start; i < end; i++)
+        {
+            OnlineLeaderboardEntry& entry = entries[i - start];
+            entry.User.Id = GetUserId(UserIds[i]);
+            entry.User.Name = GamerTagsNames[GamerTags[i]];
+            entry.User.PresenceState = OnlinePresenceStates::Offline;
+            entry.Rank = Ranks[i];
+            entry.Score = Scores[i];
+        }
+    }
+
+    void SetRows(int32 start, uint32 maxItems, int32 totalCount, const Array<OnlineLeaderboardEntry>& entries)
+    {
+        const double time = Platform::GetTimeSeconds();
+        if ((uint32)entries.Count() < maxItems)
+            TotalCount = start + entries.Count();
+        else if (totalCount != 0)
+            TotalCount = totalCount;
+        EnsureRows(Math::Min(start + entries.Count(), XBOX_LIVE_LEADERBOARD_CACHE_MAX_ROWS));
+        for (int32 i = 0; i < entries.Count() && start + i < XBOX_LIVE_LEADERBOARD_CACHE_MAX_ROWS; i++)
+            SetRow(start + i, entries[i], GetXboxUserId(entries[i].User.Id), time);
+    }
+
+    void SetRow(int32 position, const OnlineLeaderboardEntry& entry, uint64 xboxUserId, double time)
+    {
+        int32 gamerTag;
+        if (GamerTagsLookup.TryGet(xboxUserId, gamerTag))
+        {
+            // Gamertag could have been changed since the last query
+            if (GamerTagsNames[gamerTag] != entry.User.Name)
+                GamerTagsNames[gamerTag] = entry.User.Name;
+        }
+        else
+        {
+            if (GamerTagsFree.HasItems())
+            {
+                gamerTag = GamerTagsFree.Pop();
+                GamerTagsNames[gamerTag] = entry.User.Name;
+                GamerTagsRefs[gamerTag] = 0;
+            }
+            else
+            {
+                gamerTag = GamerTagsNames.Count();
+                GamerTagsNames.Add(entry.User.Name);
+                GamerTagsRefs.Add(0);
+            }
+            GamerTagsLookup.Add(xboxUserId, gamerTag);
+        }
+        const int32 prevGamerTag = GamerTags[position];
+        GamerTagsRefs[gamerTag]++;
+        if (prevGamerTag != -1 && --GamerTagsRefs[prevGamerTag] == 0)
+        {
+            // Prune gamertag of the user that is no longer in the cached rows
+            GamerTagsLookup.Remove(UserIds[position]);
+            GamerTagsNames[prevGamerTag].Clear();
+            GamerTagsFree.Add(prevGamerTag);
+        }
+        Times[position] = time;
+        Ranks[position] = entry.Rank;
+        Scores[position] = entry.Score;
+        UserIds[position] = xboxUserId;
+        GamerTags[position] = gamerTag;
+    }
+};
+
+// Leaderboard registered by GetLeaderboard (OnlineLeaderboard::Identifier is the index in the leaderboards table)
+struct XblLeaderboardInfo
+{
+    String Identifier;
+    // The leaderboard name as requested (compared in place to find the leaderboard without allocations)
+    String Title;
+    StringAnsi Name;
+    User* LocalUser = nullptr;
+    XblLeaderboardQuery Query = {};
+    XblLeaderboardCache* Cache = nullptr;
+
+    // Metadata
+    bool HasMetadata = false;
+    int32 TotalCount = 0;
+    XblLeaderboardStatType ScoreType = XblLeaderboardStatType::Int64;
+    OnlineLeaderboardValueFormats ValueFormat = OnlineLeaderboardValueFormats::Numeric;
+    Array<XblLeaderboardStatType> ColumnTypes;
+};
+
+struct XblLeaderboardsContext : XblSyncContext
+{
+    User* LocalUser = nullptr;
+    XblContextHandle Context;
+    XblLeaderboardInfo* Info = nullptr;
+    XblLeaderboardQuery Query = {};
+    Array<OnlineLeaderboardEntry>* Entries = nullptr;
+    XblLeaderboardCache* Cache = nullptr;
+    int32 CacheStart = 0;
+
+    // Leaderboard metadata and rows count decoded by the callback, applied to the shared Info and Cache on the main thread (see XblApplyLeaderboardQuery)
+    XblLeaderboardInfo Metadata;
+    int32 RowsCount = 0;
+};
+
+struct XblLeaderboardsPrefetchContext : XblLeaderboardsContext
+{
+    XAsyncBlock Async = {};
+    Array<OnlineLeaderboardEntry> Rows;
+    XblCompletionQueue* Completions = nullptr;
+};
+
+// Waits for the async Xbox Live task to be processed in a sync manner, the task is canceled once the deadline passes (0 to wait without a limit)
+bool XblSyncWait(XblSyncContext& context, XAsyncBlock& ab, XTaskQueueObject* taskQueue, double deadline)
+{
+    PROFILE_CPU();
+
+    // Throttle this thread to wait for the context to be deactivated (callbacks are dispatched here unless worker thread does it)
+    while (context.IsActive())
+    {
+        if (!Worker)
+            XblDispatch(taskQueue);
+        if (context.IsActive())
+        {
+            // Canceled task still calls the callback so keep waiting (cancel is repeated as paged queries restart the task from the callback)
+            if ((deadline > 0.0 && Platform::GetTimeSeconds() >= deadline) || XblIsCanceled(context.Operation))
+                XAsyncCancel(&ab);
+            Platform::Sleep(1);
+        }
+    }
+    return context.IsFailed();
+}
+
+// Waits for the async Xbox Live task to be processed in a sync manner, the task is canceled once the deadline passes (0 to wait without a limit)
+bool XblSyncWait(XAsyncBlock& ab, XTaskQueueObject* taskQueue, const XblOperation& operation, double deadline)
+{
+    PROFILE_CPU();
+
+    // Throttle this thread to wait for the async task to be executed
+    HRESULT result;
+    while ((result = XAsyncGetStatus(&ab, false)) == E_PENDING)
+    {
+        if (!Worker)
+            XblDispatch(taskQueue);
+        if ((deadline > 0.0 && Platform::GetTimeSeconds() >= deadline) || XblIsCanceled(operation))
+            XAsyncCancel(&ab);
+        Platform::Sleep(1);
+    }
+    return FAILED(result);
+}
+
+// Gets the deadline of the operation that starts now (0 if it has no time limit)
+double XblGetDeadline(const OnlinePlatformXboxLive& platform)
+{
+    return platform.OperationTimeout > 0.0f ? Platform::GetTimeSeconds() + platform.OperationTimeout : 0.0;
+}
+
+// Service groups tracked by the circuit breaker
+enum class XblService
+{
+    Achievements,
+    Stats,
+    Social,
+    Presence,
+    Leaderboards,
+    MAX
 };
 
-struct XblStatsContext : XblSyncContext
+const Char* XblServiceNames[] =
 {
-    float Value;
+    TEXT("Achievements"),
+    TEXT("Stats"),
+    TEXT("Social"),
+    TEXT("Presence"),
+    TEXT("Leaderboards"),
 };
 
-struct XblPresenceContext : XblSyncContext
+// Health of the service used to fail fast while it's down (instead of blocking the game on requests that will fail anyway)
+struct XblCircuitBreaker
 {
-    OnlinePresenceStates Presence;
+    int32 Failures = 0;
+    double OpenTime = 0.0;
+    bool Probing = false;
 };
 
-struct XblFriendsContext : XblSyncContext
+CriticalSection CircuitBreakersLocker;
+XblCircuitBreaker CircuitBreakers[(int32)XblService::MAX];
+
+// Checks if the request failed due to a temporary problem and can be retried (server error, timeout or throttling)
+bool XblIsTransientError(HRESULT result)
 {
-    XblContextHandle Context;
-    Array<uint64_t> FriendsIds;
-    Array<OnlineUser>* Friends;
-    int32 Iteration = 0;
-};
+    // HTTP status codes are mapped into 0x8019xxxx results
+    if (((uint32)result & 0xffff0000) == 0x80190000)
+    {
+        const uint32 status = (uint32)result & 0xffff;
+        return status == 408 || status == 429 || status >= 500;
+    }
+    return result == HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+}
 
-struct XblLeaderboardsContext : XblSyncContext
+// Checks if the service requests should fail immediately
+bool XblIsServiceDown(XblService service, float cooldown)
 {
-    XblContextHandle Context;
-    StringAnsi Name;
-    XblLeaderboardQuery Query = {};
-    Array<OnlineLeaderboardEntry>* Entries = nullptr;
-};
+    ScopeLock lock(CircuitBreakersLocker);
+    XblCircuitBreaker& breaker = CircuitBreakers[(int32)service];
+    if (breaker.OpenTime <= 0.0)
+        return false;
+    if (breaker.Probing || Platform::GetTimeSeconds() < breaker.OpenTime + cooldown)
+        return true;
+
+    // Let a single request through to check if the service is back
+    breaker.Probing = true;
+    return false;
+}
 
-// Waits for the async Xbox Live task to be processed in a sync manner
-bool XblSyncWait(const XblSyncContext& context, XTaskQueueObject* taskQueue)
+// Updates the service health with the request result (every request that passed XblIsServiceDown has to be reported)
+void XblReportService(XblService service, HRESULT result, int32 threshold)
 {
-    PROFILE_CPU();
+    ScopeLock lock(CircuitBreakersLocker);
+    XblCircuitBreaker& breaker = CircuitBreakers[(int32)service];
+    breaker.Probing = false;
+    if (result == E_ABORT)
+        return; // Canceled request tells nothing about the service health
+    if (!XblIsTransientError(result))
+    {
+        // Service responds (even if request failed for other reason)
+        if (breaker.OpenTime > 0.0)
+            LOG(Info, "Xbox Live {0} service is available again", XblServiceNames[(int32)service]);
+        breaker.Failures = 0;
+        breaker.OpenTime = 0.0;
+        return;
+    }
+    breaker.Failures++;
+    if (threshold > 0 && breaker.Failures >= threshold)
+    {
+        if (breaker.OpenTime <= 0.0)
+            LOG(Warning, "Xbox Live {0} service is unavailable, its requests will fail immediately until it's back", XblServiceNames[(int32)service]);
+        breaker.OpenTime = Platform::GetTimeSeconds();
+    }
+}
 
-    // Throttle this thread to wait for the context to be deactivated
-    while (XTaskQueueDispatch(taskQueue, XTaskQueuePort::Completion, 0) && context.Active)
-        Platform::Sleep(1);
-    return context.Failed;
+// Records the service call in the trace (if any is recording, see OnlinePlatformXboxLiveTrace)
+void XblTraceCall(const Char* method, double startTime, HRESULT result, const Array<double>* pageTimes = nullptr)
+{
+    if (OnlinePlatformXboxLiveTrace::IsRecording())
+        OnlinePlatformXboxLiveTrace::ReportServiceCall(method, startTime, result, pageTimes ? pageTimes->Get() : nullptr, pageTimes ? pageTimes->Count() : 0);
 }
 
-// Waits for the async Xbox Live task to be processed in a sync manner
-bool XblSyncWait(XAsyncBlock& ab, XTaskQueueObject* taskQueue)
+// Gets the delay (in milliseconds) before the next retry (exponential backoff with random jitter to spread the retries of many clients)
+int32 XblGetRetryDelay(const OnlinePlatformXboxLive& platform, int32 attempt)
 {
-    PROFILE_CPU();
+    const float delay = Math::Min(platform.RetryDelay * (float)(1 << Math::Min(attempt, 16)), platform.RetryMaxDelay);
+    return (int32)(delay * (0.5f + 0.5f * Random::Rand()) * 1000.0f);
+}
 
-    // Throttle this thread to wait for the async task to be executed
-    HRESULT result;
-    while ((result = XAsyncGetStatus(&ab, false)) == E_PENDING)
+// Waits before retrying the failed request, returns false if the operation should end instead (canceled or out of time)
+bool XblWaitForRetry(const OnlinePlatformXboxLive& platform, const XblOperation& operation, int32 attempt, double deadline)
+{
+    const double retryTime = Platform::GetTimeSeconds() + XblGetRetryDelay(platform, attempt) * 0.001;
+    if (deadline > 0.0 && retryTime >= deadline)
+        return false;
+    while (Platform::GetTimeSeconds() < retryTime)
     {
-        XTaskQueueDispatch(taskQueue, XTaskQueuePort::Completion, 0);
-        Platform::Sleep(1);
+        if (XblIsCanceled(operation))
+            return false;
+        Platform::Sleep(10);
     }
-    return FAILED(result);
+    return !XblIsCanceled(operation);
+}
+
+// Runs the async Xbox Live task and waits for it in a sync manner, retries transient failures and fails immediately while the service is down
+// Throttling (429/503 with Retry-After) is handled by the HTTP client retries within a single request
+// Task is canceled after OperationTimeout or with CancelOperations (for the local user)
+template<typename StartFunc>
+bool XblSyncCall(const OnlinePlatformXboxLive& platform, XblService service, User* localUser, XblSyncContext& context, XAsyncBlock& ab, XTaskQueueObject* taskQueue, const Char* method, StartFunc start)
+{
+    const double deadline = XblGetDeadline(platform);
+    context.Operation.LocalUser = localUser;
+    bool failed = true;
+    for (int32 attempt = 0;; attempt++)
+    {
+        if (XblIsServiceDown(service, platform.CircuitBreakerCooldown))
+            break;
+        context.Begin();
+        const double startTime = Platform::GetTimeSeconds();
+        HRESULT result = start(&ab);
+        if (SUCCEEDED(result))
+        {
+            XblTrackOperation(context.Operation, &ab);
+            const bool contextFailed = XblSyncWait(context, ab, taskQueue, deadline);
+            result = XAsyncGetStatus(&ab, false);
+            if (contextFailed && SUCCEEDED(result))
+                result = E_FAIL;
+            if (result == E_ABORT && !XblIsCanceled(context.Operation))
+            {
+                LOG(Warning, "Xbox Live method {0} timed out", method);
+                result = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+            }
+        }
+        else
+        {
+            LOG(Error, "Xbox Live method {0} failed with result 0x{1:x}", method, (uint32)result);
+        }
+        XblTraceCall(method, startTime, result, &context.PageTimes);
+        XblReportService(service, result, platform.CircuitBreakerThreshold);
+        if (SUCCEEDED(result))
+        {
+            failed = false;
+            break;
+        }
+        if (attempt >= platform.RetryCount || !XblIsTransientError(result) || !XblWaitForRetry(platform, context.Operation, attempt, deadline))
+            break;
+    }
+    XblUntrackOperation(context.Operation);
+    return failed;
+}
+
+// Runs multiple async Xbox Live tasks at once and waits for all of them (see XblSyncCall), the context Result holds the outcome of each task
+template<typename ContextType>
+void XblSyncCallBatch(const OnlinePlatformXboxLive& platform, XblService service, User* localUser, Array<ContextType>& contexts, XTaskQueueObject* taskQueue, const Char* method)
+{
+    const double deadline = XblGetDeadline(platform);
+    for (int32 attempt = 0;; attempt++)
+    {
+        // Check the service only if any request will be sent (half-open breaker lets through a single probe that has to be reported)
+        bool pending = false;
+        for (const ContextType& context : contexts)
+            pending |= context.Result == E_PENDING;
+        if (!pending || XblIsServiceDown(service, platform.CircuitBreakerCooldown))
+            break;
+
+        // Start all tasks (or the ones to retry)
+        const double startTime = Platform::GetTimeSeconds();
+        for (ContextType& context : contexts)
+        {
+            if (context.Result != E_PENDING)
+                continue;
+            context.Begin();
+            context.Operation.LocalUser = localUser;
+            context.Result = context.Start(&context.Async);
+            if (SUCCEEDED(context.Result))
+            {
+                context.Result = E_PENDING;
+                XblTrackOperation(context.Operation, &context.Async);
+            }
+            else
+            {
+                LOG(Error, "Xbox Live method {0} failed with result 0x{1:x}", method, (uint32)context.Result);
+                XblTraceCall(method, startTime, context.Result);
+                XblReportService(service, context.Result, platform.CircuitBreakerThreshold);
+            }
+        }
+
+        // Wait for all tasks
+        const XblOperation* retry = nullptr;
+        for (ContextType& context : contexts)
+        {
+            if (context.Result == E_PENDING)
+            {
+                const bool failed = XblSyncWait(context, context.Async, taskQueue, deadline);
+                context.Result = XAsyncGetStatus(&context.Async, false);
+                if (failed && SUCCEEDED(context.Result))
+                    context.Result = E_FAIL;
+                if (context.Result == E_ABORT && !XblIsCanceled(context.Operation))
+                {
+                    LOG(Warning, "Xbox Live method {0} timed out", method);
+                    context.Result = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+                }
+                XblTraceCall(method, startTime, context.Result, &context.PageTimes);
+                XblReportService(service, context.Result, platform.CircuitBreakerThreshold);
+            }
+            if (attempt < platform.RetryCount && XblIsTransientError(context.Result) && !XblIsCanceled(context.Operation))
+            {
+                context.Result = E_PENDING;
+                retry = &context.Operation;
+            }
+        }
+        if (!retry || !XblWaitForRetry(platform, *retry, attempt, deadline))
+            break;
+    }
+    for (ContextType& context : contexts)
+        XblUntrackOperation(context.Operation);
 }
 
 void XblGetAchievement(const XblAchievement& achievement, OnlineAchievement& result)
@@ -150,10 +1241,10 @@ void CALLBACK OnGetAchievements(_In_ XAsyncBlock* ab)
     }
     if (FAILED(result))
     {
-        achievementsContext->Failed = true;
-        achievementsContext->Active = false;
+        achievementsContext->Finish(true);
         return;
     }
+    achievementsContext->AddPage();
 
     // Get achievements from the current page
     const XblAchievement* achievements = nullptr;
@@ -170,78 +1261,259 @@ void CALLBACK OnGetAchievements(_In_ XAsyncBlock* ab)
             XblGetAchievement(achievements[i], resultAchievements[(int32)(achievementsStart + i)]);
     }
 
+    // Keep the last page to resume from it
+    if (achievementsContext->Page)
+        XblAchievementsResultCloseHandle(achievementsContext->Page);
+    achievementsContext->Page = achievementsResultHandle;
+
     // Check if has more results to process
     bool hasNextPage = false;
     result = XblAchievementsResultHasNext(achievementsResultHandle, &hasNextPage);
     XBOX_LIVE_LOG("XblAchievementsResultHasNext");
-    if (SUCCEEDED(result))
+    if (SUCCEEDED(result) && hasNextPage)
     {
-        if (hasNextPage)
-        {
-            // Go to the next page
-            achievementsContext->Iteration++;
-            XblAchievementsResultGetNextAsync(achievementsResultHandle, 1, ab);
-        }
-        else
-        {
-            // Done
-            achievementsContext->Failed = false;
-            achievementsContext->Active = false;
-        }
-        XblAchievementsResultCloseHandle(achievementsResultHandle);
-        return;
+        // Go to the next page
+        achievementsContext->Iteration++;
+        result = XblAchievementsResultGetNextAsync(achievementsResultHandle, 1, ab);
+        XBOX_LIVE_LOG("XblAchievementsResultGetNextAsync");
+        if (SUCCEEDED(result))
+            return;
     }
 
-    // Failed
-    achievementsContext->Failed = true;
-    achievementsContext->Active = false;
-    XblAchievementsResultCloseHandle(achievementsResultHandle);
+    // Done
+    achievementsContext->Finish(FAILED(result));
 }
 
-void XblGetStat(const XblStatistic& statistic, float& result)
+// Decodes the stat value text into a specific type (faster than generic parsing as service returns values in a known format)
+template<typename T>
+T XblParseValue(const char* str);
+
+template<>
+int64 XblParseValue<int64>(const char* str)
 {
-    const StringAnsiView type(statistic.statisticType);
-    result = 0.0f;
-    if (type == "Int32")
-    {
-        int32 value;
-        if (!StringUtils::Parse(statistic.value, &value))
-            result = (float)value;
-    }
-    else if (type == "Int64")
-    {
-        int64 value;
-        if (!StringUtils::Parse(statistic.value, &value))
-            result = (float)value;
-    }
-    else if (type == "UInt32")
-    {
-        uint32 value;
-        if (!StringUtils::Parse(statistic.value, &value))
-            result = (float)value;
-    }
-    else if (type == "UInt64")
+    const bool negative = *str == '-';
+    if (negative || *str == '+')
+        str++;
+    int64 value = 0;
+    while (*str >= '0' && *str <= '9')
+        value = value * 10 + (*str++ - '0');
+    return negative ? -value : value;
+}
+
+template<>
+uint64 XblParseValue<uint64>(const char* str)
+{
+    if (*str == '+')
+        str++;
+    uint64 value = 0;
+    while (*str >= '0' && *str <= '9')
+        value = value * 10 + (*str++ - '0');
+    return value;
+}
+
+template<>
+double XblParseValue<double>(const char* str)
+{
+    return strtod(str, nullptr);
+}
+
+template<XblLeaderboardStatType Type>
+int32 XblGetLeaderboardScore(const char* str);
+
+template<>
+int32 XblGetLeaderboardScore<XblLeaderboardStatType::Int64>(const char* str)
+{
+    return (int32)Math::Clamp<int64>(XblParseValue<int64>(str), MIN_int32, MAX_int32);
+}
+
+template<>
+int32 XblGetLeaderboardScore<XblLeaderboardStatType::Double>(const char* str)
+{
+    const double value = XblParseValue<double>(str);
+    return (int32)Math::Clamp<double>(value >= 0.0 ? value + 0.5 : value - 0.5, MIN_int32, MAX_int32);
+}
+
+template<XblLeaderboardStatType Type>
+void XblGetLeaderboardRows(const XblLeaderboardResult& leaderboard, Array<OnlineLeaderboardEntry>& entries)
+{
+    entries.Resize((int32)leaderboard.rowsCount);
+    for (size_t i = 0u; i < leaderboard.rowsCount; i++)
     {
-        uint64 value;
-        if (!StringUtils::Parse(statistic.value, &value))
-            result = (float)value;
+        const XblLeaderboardRow& row = leaderboard.rows[i];
+        OnlineLeaderboardEntry& entry = entries[(int32)i];
+
+        entry.User.Id = GetUserId(row.xboxUserId);
+        ProfileCache.Set(row.xboxUserId, row.modernGamertag, entry.User.Name);
+        entry.User.PresenceState = OnlinePresenceStates::Offline;
+        entry.Rank = (int32)row.globalRank;
+        entry.Score = row.columnValuesCount != 0 && row.columnValues ? XblGetLeaderboardScore<Type>(row.columnValues[0]) : 0;
     }
-    else if (type == "Float")
+}
+
+void XblGetLeaderboardMetadata(const XblLeaderboardResult& leaderboard, XblLeaderboardInfo& info)
+{
+    info.HasMetadata = true;
+    info.ColumnTypes.Resize((int32)leaderboard.columnsCount);
+    for (size_t i = 0u; i < leaderboard.columnsCount; i++)
+        info.ColumnTypes[(int32)i] = leaderboard.columns[i].statType;
+    info.ScoreType = leaderboard.columnsCount != 0 && leaderboard.columns[0].statType == XblLeaderboardStatType::Double ? XblLeaderboardStatType::Double : XblLeaderboardStatType::Int64;
+    info.ValueFormat = OnlineLeaderboardValueFormats::Numeric;
+}
+
+// Stat types reported by the service
+enum class XblStatType
+{
+    Int32,
+    Int64,
+    UInt32,
+    UInt64,
+    Float,
+    Double,
+    Bool,
+    Unknown,
+};
+
+const char* XblStatTypeNames[] =
+{
+    "Int32",
+    "Int64",
+    "UInt32",
+    "UInt64",
+    "Float",
+    "Double",
+    "Bool",
+};
+
+template<XblStatType Type>
+void XblParseStat(const char* str, XboxLiveStatValue& result);
+
+template<>
+void XblParseStat<XblStatType::Int64>(const char* str, XboxLiveStatValue& result)
+{
+    result.Type = XboxLiveStatTypes::Int64;
+    result.IntValue = XblParseValue<int64>(str);
+}
+
+template<>
+void XblParseStat<XblStatType::Int32>(const char* str, XboxLiveStatValue& result)
+{
+    XblParseStat<XblStatType::Int64>(str, result);
+}
+
+template<>
+void XblParseStat<XblStatType::UInt32>(const char* str, XboxLiveStatValue& result)
+{
+    XblParseStat<XblStatType::Int64>(str, result);
+}
+
+template<>
+void XblParseStat<XblStatType::UInt64>(const char* str, XboxLiveStatValue& result)
+{
+    result.Type = XboxLiveStatTypes::Int64;
+    const uint64 value = XblParseValue<uint64>(str);
+    result.IntValue = value > (uint64)MAX_int64 ? MAX_int64 : (int64)value;
+}
+
+template<>
+void XblParseStat<XblStatType::Double>(const char* str, XboxLiveStatValue& result)
+{
+    result.Type = XboxLiveStatTypes::Double;
+    result.DoubleValue = XblParseValue<double>(str);
+}
+
+template<>
+void XblParseStat<XblStatType::Float>(const char* str, XboxLiveStatValue& result)
+{
+    XblParseStat<XblStatType::Double>(str, result);
+}
+
+template<>
+void XblParseStat<XblStatType::Bool>(const char* str, XboxLiveStatValue& result)
+{
+    result.Type = XboxLiveStatTypes::Bool;
+    result.BoolValue = (str[0] == '1' && str[1] == 0) || StringUtils::CompareIgnoreCase(str, "true") == 0;
+}
+
+template<>
+void XblParseStat<XblStatType::Unknown>(const char* str, XboxLiveStatValue& result)
+{
+    result = XboxLiveStatValue();
+}
+
+typedef void (*XblStatParser)(const char* str, XboxLiveStatValue& result);
+
+const XblStatParser XblStatParsers[] =
+{
+    XblParseStat<XblStatType::Int32>,
+    XblParseStat<XblStatType::Int64>,
+    XblParseStat<XblStatType::UInt32>,
+    XblParseStat<XblStatType::UInt64>,
+    XblParseStat<XblStatType::Float>,
+    XblParseStat<XblStatType::Double>,
+    XblParseStat<XblStatType::Bool>,
+    XblParseStat<XblStatType::Unknown>,
+};
+
+XblStatParser XblResolveStatParser(const char* statisticType)
+{
+    const StringAnsiView typeName(statisticType);
+    for (int32 i = 0; i < ARRAY_COUNT(XblStatTypeNames); i++)
     {
-        float value;
-        if (!StringUtils::Parse(statistic.value, &value))
-            result = value;
+        if (typeName == XblStatTypeNames[i])
+            return XblStatParsers[i];
     }
-    else if (type == "Double")
+    return XblStatParsers[(int32)XblStatType::Unknown];
+}
+
+// Cached parser of each stat (stat type is set in the service configuration so its name is parsed only once per stat, stats are keyed by the service configuration too as the same name can have a different type in another one)
+struct XblStatTypeEntry
+{
+    StringAnsi Scid;
+    StringAnsi Name;
+    XblStatParser Parser;
+};
+
+CriticalSection StatTypesLocker;
+Dictionary<uint64, XblStatTypeEntry> StatTypes;
+
+XblStatParser XblGetStatParser(const char* scid, const XblStatistic& statistic)
+{
+    const StringAnsiView scidView(scid);
+    const StringAnsiView name(statistic.statisticName);
+    const uint64 key = ((uint64)GetHash(scidView) << 32) | (uint64)GetHash(name);
+    ScopeLock lock(StatTypesLocker);
+    XblStatTypeEntry* entry = StatTypes.TryGet(key);
+    if (entry && StringAnsiView(entry->Scid) == scidView && StringAnsiView(entry->Name) == name)
+        return entry->Parser;
+    const XblStatParser parser = XblResolveStatParser(statistic.statisticType);
+    if (!entry)
     {
-        float value;
-        if (!StringUtils::Parse(statistic.value, &value))
-            result = value;
+        // Hash collisions are resolved each time (not cached)
+        entry = &StatTypes[key];
+        entry->Scid = StringAnsi(scidView);
+        entry->Name = StringAnsi(name);
+        entry->Parser = parser;
     }
-    else if (type == "Bool")
+    return parser;
+}
+
+void XblGetStat(const char* scid, const XblStatistic& statistic, XboxLiveStatValue& result)
+{
+    XblGetStatParser(scid, statistic)(statistic.value, result);
+}
+
+float XblGetStatFloat(const XboxLiveStatValue& value)
+{
+    switch (value.Type)
     {
-        const StringAnsiView value(statistic.value);
-        result = (value == "1" || value.Compare(StringAnsiView("true"), StringSearchCase::IgnoreCase) == 0) ? 1.0f : 0.0f;
+    case XboxLiveStatTypes::Int64:
+        return (float)value.IntValue;
+    case XboxLiveStatTypes::Double:
+        return (float)value.DoubleValue;
+    case XboxLiveStatTypes::Bool:
+        return value.BoolValue ? 1.0f : 0.0f;
+    default:
+        return 0.0f;
     }
 }
 
@@ -249,29 +1521,141 @@ void CALLBACK OnGetStat(_In_ XAsyncBlock* ab)
 {
     PROFILE_CPU();
     XblStatsContext* statsContext = (XblStatsContext*)ab->context;
-    Array<uint8_t> buffer;
     size_t size = 0;
     HRESULT result = XblUserStatisticsGetSingleUserStatisticResultSize(ab, &size);
     XBOX_LIVE_LOG("XblUserStatisticsGetSingleUserStatisticResultSize");
     if (SUCCEEDED(result))
     {
-        buffer.Resize((int32)size);
         XblUserStatisticsResult* statisticsResult = nullptr;
-        XblUserStatisticsGetSingleUserStatisticResult(ab, size, buffer.Get(), &statisticsResult, &size);
+        result = XblUserStatisticsGetSingleUserStatisticResult(ab, size, Scratch.GetBuffer(size), &statisticsResult, &size);
         XBOX_LIVE_LOG("XblUserStatisticsGetSingleUserStatisticResult");
-        if (SUCCEEDED(result) && statisticsResult && statisticsResult->serviceConfigStatisticsCount > 0 && statisticsResult->serviceConfigStatistics[0].statisticsCount > 0)
+        if (SUCCEEDED(result) && statisticsResult)
+        {
+            // Get statistic value (stat that was never set has no value)
+            if (statisticsResult->serviceConfigStatisticsCount > 0 && statisticsResult->serviceConfigStatistics[0].statisticsCount > 0)
+            {
+                const XblServiceConfigurationStatistic& serviceStatistics = statisticsResult->serviceConfigStatistics[0];
+                const XblStatistic& statistic = serviceStatistics.statistics[0];
+                statsContext->Exists = statistic.value && statistic.value[0] != 0;
+                if (statsContext->Exists)
+                    XblGetStat(serviceStatistics.serviceConfigurationId, statistic, statsContext->Value);
+            }
+            statsContext->Finish(false);
+            return;
+        }
+    }
+
+    // Failed
+    statsContext->Finish(true);
+}
+
+void CALLBACK OnGetServiceStats(_In_ XAsyncBlock* ab)
+{
+    PROFILE_CPU();
+    XblServiceStatsContext* statsContext = (XblServiceStatsContext*)ab->context;
+    size_t size = 0;
+    HRESULT result = XblUserStatisticsGetMultipleUserStatisticsResultSize(ab, &size);
+    XBOX_LIVE_LOG("XblUserStatisticsGetMultipleUserStatisticsResultSize");
+    if (SUCCEEDED(result))
+    {
+        XblUserStatisticsResult* statisticsResults = nullptr;
+        size_t statisticsResultsCount = 0;
+        result = XblUserStatisticsGetMultipleUserStatisticsResult(ab, size, Scratch.GetBuffer(size), &statisticsResults, &statisticsResultsCount, nullptr);
+        XBOX_LIVE_LOG("XblUserStatisticsGetMultipleUserStatisticsResult");
+        if (SUCCEEDED(result))
         {
-            // Get statistic value
-            XblGetStat(statisticsResult->serviceConfigStatistics[0].statistics[0], statsContext->Value);
-            statsContext->Failed = false;
-            statsContext->Active = false;
+            // Get statistic values (single user)
+            for (size_t i = 0; i < statisticsResultsCount; i++)
+            {
+                const XblUserStatisticsResult& statisticsResult = statisticsResults[i];
+                for (size_t j = 0; j < statisticsResult.serviceConfigStatisticsCount; j++)
+                {
+                    const XblServiceConfigurationStatistic& serviceStatistics = statisticsResult.serviceConfigStatistics[j];
+                    for (size_t k = 0; k < serviceStatistics.statisticsCount; k++)
+                    {
+                        const XblStatistic& statistic = serviceStatistics.statistics[k];
+                        auto& stat = statsContext->Results.AddOne();
+                        stat.Scid = statsContext->Scid;
+                        stat.Name = statistic.statisticName;
+                        XblGetStat(serviceStatistics.serviceConfigurationId, statistic, stat.TypedValue);
+                        stat.Value = XblGetStatFloat(stat.TypedValue);
+                    }
+                }
+            }
+            statsContext->Finish(false);
             return;
         }
     }
 
     // Failed
-    statsContext->Failed = true;
-    statsContext->Active = false;
+    statsContext->Finish(true);
+}
+
+void CALLBACK OnUpdateStats(_In_ XAsyncBlock* ab)
+{
+    PROFILE_CPU();
+    XblStatsUpdateContext* context = (XblStatsUpdateContext*)ab->context;
+    HRESULT result = XAsyncGetStatus(ab, false);
+    XBOX_LIVE_LOG("XblTitleManagedStatsUpdateStatsAsync");
+    context->Completions->Add(XblCompletion::Types::StatsUpdate, context);
+}
+
+void CALLBACK OnUpdateAchievement(_In_ XAsyncBlock* ab)
+{
+    XblAchievementUpdateContext* context = (XblAchievementUpdateContext*)ab->context;
+    context->Completions->Add(XblCompletion::Types::AchievementUpdate, context);
+}
+
+void CALLBACK OnInitializeSaveProvider(_In_ XAsyncBlock* ab)
+{
+    XblSaveProviderContext* context = (XblSaveProviderContext*)ab->context;
+    context->Completions->Add(XblCompletion::Types::SaveProviderInit, context);
+}
+
+void CALLBACK OnSetPresence(_In_ XAsyncBlock* ab)
+{
+    XblPresenceUpdateContext* context = (XblPresenceUpdateContext*)ab->context;
+    context->Completions->Add(XblCompletion::Types::PresenceUpdate, context);
+}
+
+void CALLBACK OnUserChange(_In_opt_ void* context, _In_ XUserLocalId userLocalId, _In_ XUserChangeEvent event)
+{
+    // Handle change on the main thread
+    XblCompletion completion;
+    completion.Type = XblCompletion::Types::UserChange;
+    completion.Context = nullptr;
+    completion.XboxUserId = 0;
+    completion.Presence = OnlinePresenceStates::Offline;
+    completion.UserLocalId = userLocalId.value;
+    completion.UserChange = event;
+    if (event == XUserChangeEvent::SigningOut)
+    {
+        // Delay the sign out until the last user data is sent (deferral has to be taken within this callback)
+        XUserSignOutDeferralHandle deferral;
+        if (SUCCEEDED(XUserGetSignOutDeferral(&deferral)))
+            completion.Context = deferral;
+    }
+    ((XblCompletionQueue*)context)->ConcurrentQueue<XblCompletion>::Add(completion);
+}
+
+OnlinePresenceStates XblGetPresenceState(XblPresenceRecordHandle presenceRecord)
+{
+    XblPresenceUserState userState;
+    HRESULT result = XblPresenceRecordGetUserState(presenceRecord, &userState);
+    XBOX_LIVE_LOG("XblPresenceRecordGetUserState");
+    if (SUCCEEDED(result))
+    {
+        switch (userState)
+        {
+        case XblPresenceUserState::Away:
+            return OnlinePresenceStates::Away;
+        case XblPresenceUserState::Offline:
+            return OnlinePresenceStates::Offline;
+        default:
+            break;
+        }
+    }
+    return OnlinePresenceStates::Online;
 }
 
 void CALLBACK OnGetPresence(_In_ XAsyncBlock* ab)
@@ -283,33 +1667,94 @@ void CALLBACK OnGetPresence(_In_ XAsyncBlock* ab)
     XBOX_LIVE_LOG("XblPresenceGetPresenceResult");
     if (SUCCEEDED(result))
     {
-        XblPresenceUserState userState;
-        result = XblPresenceRecordGetUserState(presenceRecord, &userState);
-        XBOX_LIVE_LOG("XblPresenceRecordGetUserState");
+        presenceContext->Presence = XblGetPresenceState(presenceRecord);
+        XblPresenceRecordCloseHandle(presenceRecord);
+        presenceContext->Finish(false);
+        return;
+    }
+
+    // Failed
+    presenceContext->Finish(true);
+}
+
+void CALLBACK OnGetPresenceForUsers(_In_ XAsyncBlock* ab)
+{
+    PROFILE_CPU();
+    XblPresenceUsersContext* presenceContext = (XblPresenceUsersContext*)ab->context;
+    size_t count = 0;
+    HRESULT result = XblPresenceGetPresenceForMultipleUsersResultCount(ab, &count);
+    XBOX_LIVE_LOG("XblPresenceGetPresenceForMultipleUsersResultCount");
+    if (SUCCEEDED(result))
+    {
+        auto& presenceRecords = Scratch.PresenceRecords;
+        result = XblPresenceGetPresenceForMultipleUsersResult(ab, Scratch.Get(presenceRecords, (int32)count), count);
+        XBOX_LIVE_LOG("XblPresenceGetPresenceForMultipleUsersResult");
         if (SUCCEEDED(result))
         {
-            switch (userState)
+            for (XblPresenceRecordHandle presenceRecord : presenceRecords)
             {
-            case XblPresenceUserState::Away:
-                presenceContext->Presence = OnlinePresenceStates::Away;
-                break;
-            case XblPresenceUserState::Offline:
-                presenceContext->Presence = OnlinePresenceStates::Offline;
-                break;
-            default:
-                presenceContext->Presence = OnlinePresenceStates::Online;
-                break;
+                uint64_t xboxUserId;
+                if (SUCCEEDED(XblPresenceRecordGetXuid(presenceRecord, &xboxUserId)))
+                    presenceContext->Presence->Set(xboxUserId, XblGetPresenceState(presenceRecord));
+                XblPresenceRecordCloseHandle(presenceRecord);
             }
+
+            // Done
+            presenceContext->Finish(false);
+            return;
         }
-        XblPresenceRecordCloseHandle(presenceRecord);
-        presenceContext->Failed = false;
-        presenceContext->Active = false;
-        return;
     }
 
     // Failed
-    presenceContext->Failed = true;
-    presenceContext->Active = false;
+    presenceContext->Finish(true);
+}
+
+void CALLBACK OnQueryPresenceForUsers(_In_ XAsyncBlock* ab)
+{
+    PROFILE_CPU();
+    XblPresenceQueryContext* queryContext = (XblPresenceQueryContext*)ab->context;
+    size_t count = 0;
+    HRESULT result = XblPresenceGetPresenceForMultipleUsersResultCount(ab, &count);
+    if (result != E_ABORT)
+        XBOX_LIVE_LOG("XblPresenceGetPresenceForMultipleUsersResultCount");
+    if (SUCCEEDED(result))
+    {
+        auto& presenceRecords = Scratch.PresenceRecords;
+        result = XblPresenceGetPresenceForMultipleUsersResult(ab, Scratch.Get(presenceRecords, (int32)count), count);
+        XBOX_LIVE_LOG("XblPresenceGetPresenceForMultipleUsersResult");
+        if (SUCCEEDED(result))
+        {
+            for (XblPresenceRecordHandle presenceRecord : presenceRecords)
+            {
+                uint64_t xboxUserId;
+                if (SUCCEEDED(XblPresenceRecordGetXuid(presenceRecord, &xboxUserId)))
+                    queryContext->Completions->AddPresence(xboxUserId, XblGetPresenceState(presenceRecord));
+                XblPresenceRecordCloseHandle(presenceRecord);
+            }
+        }
+    }
+    queryContext->Completions->Add(XblCompletion::Types::PresenceQuery, queryContext);
+}
+
+// Presence handlers only pass the events to the main thread (handler can still run on the dispatching thread after its subscription was removed)
+void CALLBACK OnDevicePresenceChanged(_In_opt_ void* context, _In_ uint64_t xboxUserId, _In_ XblPresenceDeviceType deviceType, _In_ bool isUserLoggedOnDevice)
+{
+    XblCompletionQueue* completions = (XblCompletionQueue*)context;
+    if (isUserLoggedOnDevice)
+        completions->AddPresence(xboxUserId, OnlinePresenceStates::Online);
+    else
+        completions->AddPresence(xboxUserId, OnlinePresenceStates::Offline, XblCompletion::Types::PresenceLeft);
+}
+
+void CALLBACK OnTitlePresenceChanged(_In_opt_ void* context, _In_ uint64_t xboxUserId, _In_ uint32_t titleId, _In_ XblPresenceTitleState titleState)
+{
+    XblCompletionQueue* completions = (XblCompletionQueue*)context;
+    if (titleId != completions->TitleId)
+        return;
+    if (titleState == XblPresenceTitleState::Started)
+        completions->AddPresence(xboxUserId, OnlinePresenceStates::Online);
+    else
+        completions->AddPresence(xboxUserId, OnlinePresenceStates::Offline, XblCompletion::Types::PresenceLeft);
 }
 
 void CALLBACK OnGetFriendsIds(_In_ XAsyncBlock* ab)
@@ -321,26 +1766,26 @@ void CALLBACK OnGetFriendsIds(_In_ XAsyncBlock* ab)
     if (friendsContext->Iteration == 0)
     {
         // Get results
-        result = XblSocialGetSocialRelationshipsResult(ab, &socialRelationship);
+        result = Backend->SocialGetSocialRelationshipsResult(ab, &socialRelationship);
         XBOX_LIVE_LOG("XblSocialGetSocialRelationshipsResult");
     }
     else
     {
         // Get next page results
-        result = XblSocialRelationshipResultGetNextResult(ab, &socialRelationship);
+        result = Backend->SocialRelationshipResultGetNextResult(ab, &socialRelationship);
         XBOX_LIVE_LOG("XblSocialRelationshipResultGetNextResult");
     }
     if (FAILED(result))
     {
-        friendsContext->Failed = true;
-        friendsContext->Active = false;
+        friendsContext->Finish(true);
         return;
     }
+    friendsContext->AddPage();
 
     // Get relationships from the current page
     const XblSocialRelationship* relationships = nullptr;
     size_t relationshipsCount = 0;
-    result = XblSocialRelationshipResultGetRelationships(socialRelationship, &relationships, &relationshipsCount);
+    result = Backend->SocialRelationshipResultGetRelationships(socialRelationship, &relationships, &relationshipsCount);
     XBOX_LIVE_LOG("XblSocialRelationshipResultGetRelationships");
     if (SUCCEEDED(result))
     {
@@ -352,32 +1797,27 @@ void CALLBACK OnGetFriendsIds(_In_ XAsyncBlock* ab)
             resultFriends[(int32)(friendsStart + i)] = relationships[i].xboxUserId;
     }
 
+    // Keep the last page to resume from it
+    if (friendsContext->Page)
+        Backend->SocialRelationshipResultCloseHandle(friendsContext->Page);
+    friendsContext->Page = socialRelationship;
+
     // Check if has more results to process
     bool hasNextPage = false;
-    result = XblSocialRelationshipResultHasNext(socialRelationship, &hasNextPage);
+    result = Backend->SocialRelationshipResultHasNext(socialRelationship, &hasNextPage);
     XBOX_LIVE_LOG("XblSocialRelationshipResultHasNext");
-    if (SUCCEEDED(result))
+    if (SUCCEEDED(result) && hasNextPage)
     {
-        if (hasNextPage)
-        {
-            // Go to the next page
-            friendsContext->Iteration++;
-            XblSocialRelationshipResultGetNextAsync(friendsContext->Context, socialRelationship, 0, ab);
-        }
-        else
-        {
-            // Done
-            friendsContext->Failed = false;
-            friendsContext->Active = false;
-        }
-        XblSocialRelationshipResultCloseHandle(socialRelationship);
-        return;
+        // Go to the next page
+        friendsContext->Iteration++;
+        result = Backend->SocialRelationshipResultGetNextAsync(friendsContext->Context, socialRelationship, 0, ab);
+        XBOX_LIVE_LOG("XblSocialRelationshipResultGetNextAsync");
+        if (SUCCEEDED(result))
+            return;
     }
 
-    // Failed
-    friendsContext->Failed = true;
-    friendsContext->Active = false;
-    XblSocialRelationshipResultCloseHandle(socialRelationship);
+    // Done
+    friendsContext->Finish(FAILED(result));
 }
 
 void CALLBACK OnGetFriendsProfiles(_In_ XAsyncBlock* ab)
@@ -385,37 +1825,34 @@ void CALLBACK OnGetFriendsProfiles(_In_ XAsyncBlock* ab)
     PROFILE_CPU();
     XblFriendsContext* friendsContext = (XblFriendsContext*)ab->context;
     size_t profileCount;
-    HRESULT result = XblProfileGetUserProfilesResultCount(ab, &profileCount);
+    HRESULT result = Backend->ProfileGetUserProfilesResultCount(ab, &profileCount);
     XBOX_LIVE_LOG("XblProfileGetUserProfilesResultCount");
     if (SUCCEEDED(result))
     {
-        Array<XblUserProfile> profiles;
-        profiles.Resize((int32)profileCount);
-        result = XblProfileGetUserProfilesResult(ab, profileCount, profiles.Get());
+        auto& profiles = Scratch.Profiles;
+        result = Backend->ProfileGetUserProfilesResult(ab, profileCount, Scratch.Get(profiles, (int32)profileCount));
         XBOX_LIVE_LOG("XblProfileGetUserProfilesResult");
         if (SUCCEEDED(result))
         {
-            friendsContext->Friends->Resize(profiles.Count());
+            const double time = Platform::GetTimeSeconds();
             for (int32 i = 0; i < profiles.Count(); i++)
             {
                 const XblUserProfile& profile = profiles[i];
-                OnlineUser& f = friendsContext->Friends->At(i);
-                f.Id = GetUserId(profile.xboxUserId);
-                f.Name = profile.modernGamertag;
-                // TODO: query presence for friends
-                f.PresenceState = OnlinePresenceStates::Online;
+                int32 index;
+                if (!friendsContext->ProfilesLookup.TryGet(profile.xboxUserId, index))
+                    continue;
+                OnlineUser& f = friendsContext->Friends->At(index);
+                ProfileCache.Set(profile.xboxUserId, profile.modernGamertag, f.Name, profile.gameDisplayPictureResizeUri, time);
             }
         }
 
         // Done
-        friendsContext->Failed = false;
-        friendsContext->Active = false;
+        friendsContext->Finish(false);
         return;
     }
 
     // Failed
-    friendsContext->Failed = true;
-    friendsContext->Active = false;
+    friendsContext->Finish(true);
 }
 
 void CALLBACK OnGetLeaderboard(_In_ XAsyncBlock* ab)
@@ -423,47 +1860,74 @@ void CALLBACK OnGetLeaderboard(_In_ XAsyncBlock* ab)
     PROFILE_CPU();
     XblLeaderboardsContext* context = (XblLeaderboardsContext*)ab->context;
     size_t resultSizeInBytes;
-    HRESULT result = XblLeaderboardGetLeaderboardResultSize(ab, &resultSizeInBytes);
+    HRESULT result = Backend->LeaderboardGetLeaderboardResultSize(ab, &resultSizeInBytes);
     XBOX_LIVE_LOG("XblLeaderboardGetLeaderboardResultSize");
     if (SUCCEEDED(result))
     {
-        void* results = Allocator::Allocate(resultSizeInBytes);
         XblLeaderboardResult* leaderboard = nullptr;
-        result = XblLeaderboardGetLeaderboardResult(ab, resultSizeInBytes, results, &leaderboard, nullptr);
+        result = Backend->LeaderboardGetLeaderboardResult(ab, resultSizeInBytes, Scratch.GetBuffer(resultSizeInBytes), &leaderboard, nullptr);
         XBOX_LIVE_LOG("XblLeaderboardGetLeaderboardResult");
         if (SUCCEEDED(result))
         {
-            context->Entries->Resize((int32)leaderboard->rowsCount);
-            for (size_t i = 0u; i < leaderboard->rowsCount; i++)
-            {
-                const XblLeaderboardRow& row = leaderboard->rows[i];
-                OnlineLeaderboardEntry& entry = context->Entries->At((int32)i);
-
-                entry.User.Id = GetUserId(row.xboxUserId);
-                entry.User.Name.SetUTF8(row.modernGamertag, StringUtils::Length(row.modernGamertag));
-                entry.User.PresenceState = OnlinePresenceStates::Offline;
-                entry.Rank = (int32)row.globalRank;
-                entry.Score = 0;
-                if (row.columnValuesCount != 0 && row.columnValues)
-                {
-                    StringUtils::Parse(row.columnValues[0], &entry.Score);
-                }
-            }
+            // Decode leaderboard metadata on the first query
+            XblLeaderboardInfo& metadata = context->Metadata;
+            if (!metadata.HasMetadata)
+                XblGetLeaderboardMetadata(*leaderboard, metadata);
+            if (context->Query.socialGroup == XblSocialGroupType::None && leaderboard->totalRowCount != 0)
+                metadata.TotalCount = (int32)leaderboard->totalRowCount;
+            context->RowsCount = (int32)leaderboard->totalRowCount;
+
+            // Decode rows using the score column type
+            if (metadata.ScoreType == XblLeaderboardStatType::Double)
+                XblGetLeaderboardRows<XblLeaderboardStatType::Double>(*leaderboard, *context->Entries);
+            else
+                XblGetLeaderboardRows<XblLeaderboardStatType::Int64>(*leaderboard, *context->Entries);
             // TODO: support next results page via XblLeaderboardResultGetNextAsync and XblLeaderboardResultGetNextResult
         }
-        Allocator::Free(results);
         if (SUCCEEDED(result))
         {
             // Done
-            context->Failed = false;
-            context->Active = false;
+            context->Finish(false);
             return;
         }
     }
 
     // Failed
-    context->Failed = true;
-    context->Active = false;
+    context->Finish(true);
+}
+
+void CALLBACK OnPrefetchLeaderboard(_In_ XAsyncBlock* ab)
+{
+    PROFILE_CPU();
+    XblLeaderboardsPrefetchContext* context = (XblLeaderboardsPrefetchContext*)ab->context;
+    OnGetLeaderboard(ab);
+    context->Completions->Add(XblCompletion::Types::LeaderboardPrefetch, context);
+}
+
+// Prepares the leaderboard query on the main thread (callback decodes results into the context as the shared leaderboard info and cache are used only on the main thread)
+void XblBeginLeaderboardQuery(XblLeaderboardsContext& context)
+{
+    context.Metadata.HasMetadata = context.Info->HasMetadata;
+    context.Metadata.ScoreType = context.Info->ScoreType;
+    context.Metadata.TotalCount = 0;
+    context.RowsCount = 0;
+}
+
+// Applies the results of the finished leaderboard query to the shared leaderboard info and cache on the main thread
+void XblApplyLeaderboardQuery(XblLeaderboardsContext& context)
+{
+    XblLeaderboardInfo& info = *context.Info;
+    if (!info.HasMetadata && context.Metadata.HasMetadata)
+    {
+        info.HasMetadata = true;
+        info.ColumnTypes = MoveTemp(context.Metadata.ColumnTypes);
+        info.ScoreType = context.Metadata.ScoreType;
+        info.ValueFormat = context.Metadata.ValueFormat;
+    }
+    if (context.Metadata.TotalCount != 0)
+        info.TotalCount = context.Metadata.TotalCount;
+    if (context.Cache)
+        context.Cache->SetRows(context.CacheStart, context.Query.maxItems, context.RowsCount, *context.Entries);
 }
 
 OnlinePlatformXboxLive::OnlinePlatformXboxLive(const SpawnParams& params)
@@ -471,9 +1935,21 @@ OnlinePlatformXboxLive::OnlinePlatformXboxLive(const SpawnParams& params)
 {
 }
 
+OnlinePlatformXboxLive* OnlinePlatformXboxLive::GetInstance()
+{
+    return ActivePlatform;
+}
+
 bool OnlinePlatformXboxLive::Initialize()
 {
+    if (ActivePlatform)
+    {
+        LOG(Error, "Xbox Live is already initialized by another online platform");
+        return true;
+    }
+
     // Initialize
+    Backend = Service ? Service : &XboxLiveService::GetDefault();
     uint32_t titleId = 0;
     HRESULT result = S_OK;
     result = XGameGetXboxTitleId(&titleId);
@@ -484,7 +1960,10 @@ bool OnlinePlatformXboxLive::Initialize()
     LOG(Info, "Initializing Xbox Live with TitleId={0}, SandboxId={1}", titleId, String(sandboxId));
     if (FAILED(XTaskQueueCreate(XTaskQueueDispatchMode::ThreadPool, XTaskQueueDispatchMode::Manual, &_taskQueue)))
         return true;
-    XblMemSetFunctions(XblMemAlloc, XblMemFree);
+    Platform::AtomicStore(&QueuedCallbacks, 0);
+    XTaskQueueRegistrationToken monitorToken;
+    if (SUCCEEDED(XTaskQueueRegisterMonitor(_taskQueue, nullptr, OnTaskQueueSubmit, &monitorToken)))
+        _taskQueueMonitorToken = monitorToken.token;
     const auto settings = PlatformSettings::Get();
     XblInitArgs xblArgs = {};
     xblArgs.queue = _taskQueue;
@@ -492,10 +1971,30 @@ bool OnlinePlatformXboxLive::Initialize()
         xblArgs.scid = settings->SCID.Get();
     else
         xblArgs.scid = "00000000-0000-0000-0000-000000000000";
-    result = XblInitialize(&xblArgs);
+    result = Backend->Initialize(&xblArgs);
     XBOX_LIVE_CHECK_RETURN("XblInitialize");
+    ActivePlatform = this;
     _titleId = titleId;
+    _completions = New<XblCompletionQueue>();
+    _completions->TitleId = titleId;
+    if (UseWorkerThread)
+    {
+        // Dispatch callbacks and marshal results on a dedicated thread
+        Worker = New<XblWorker>();
+        Worker->Queue = _taskQueue;
+        Worker->WorkerThread = Thread::Create(Worker, TEXT("Xbox Live"), ThreadPriority::BelowNormal);
+        if (!Worker->WorkerThread)
+        {
+            LOG(Error, "Failed to create Xbox Live worker thread");
+            Delete(Worker);
+            Worker = nullptr;
+        }
+    }
     Engine::LateUpdate.Bind<OnlinePlatformXboxLive, &OnlinePlatformXboxLive::OnUpdate>(this);
+    XTaskQueueRegistrationToken userChangeToken;
+    result = Backend->UserRegisterForChangeEvent(_taskQueue, _completions, OnUserChange, &userChangeToken);
+    XBOX_LIVE_LOG("XUserRegisterForChangeEvent");
+    _userChangeToken = SUCCEEDED(result) ? userChangeToken.token : 0;
 
 #if !BUILD_RELEASE
     // Debugging
@@ -511,53 +2010,150 @@ bool OnlinePlatformXboxLive::Initialize()
 
 void OnlinePlatformXboxLive::Deinitialize()
 {
+    if (ActivePlatform && ActivePlatform != this)
+        return;
+    if (_userChangeToken != 0)
+    {
+        XUserUnregisterForChangeEvent({ _userChangeToken }, true);
+        _userChangeToken = 0;
+    }
+
+    // Send pending stats and wait for the background tasks to end
+    FlushStats();
+    Array<User*> presenceUsers;
+    _presenceSubscriptions.GetKeys(presenceUsers);
+    for (User* user : presenceUsers)
+        ClosePresenceSubscription(user);
+    _presence.Clear();
+    _presenceRefs.Clear();
+    _presenceChanges.Clear();
+    DrainOperations(nullptr);
+    if (_backgroundTasks == 0)
+    {
+        _leaderboards.ClearDelete();
+        _leaderboardCaches.ClearDelete();
+    }
+    _stats.ClearDelete();
+    _richPresence.ClearDelete();
+    ProfileCache.Clear();
+    {
+        ScopeLock lock(StatTypesLocker);
+        StatTypes.Clear();
+    }
     for (const auto& e : _gameSaveProviders)
-        XGameSaveCloseProvider(e.Value);
+        Backend->GameSaveCloseProvider(e.Value);
     _gameSaveProviders.Clear();
     for (const auto& e : _users)
-        XblContextCloseHandle(e.Value);
+        Backend->ContextCloseHandle(e.Value);
     _users.Clear();
+    _localUsers.Clear();
+    for (const auto& e : _signOutDeferrals)
+        XUserCloseSignOutDeferralHandle(e.Value);
+    _signOutDeferrals.Clear();
     Engine::LateUpdate.Unbind<OnlinePlatformXboxLive, &OnlinePlatformXboxLive::OnUpdate>(this);
-    static XAsyncBlock emptyBlock{nullptr, nullptr, nullptr};
-    XblCleanupAsync(&emptyBlock);
+
+    // Cleanup SDK (block is static as it has to outlive this call if cleanup doesn't end in time)
+    static XAsyncBlock cleanupBlock;
+    cleanupBlock = {};
+    cleanupBlock.queue = _taskQueue;
+    HRESULT result = Backend->CleanupAsync(&cleanupBlock);
+    XBOX_LIVE_LOG("XblCleanupAsync");
+    if (SUCCEEDED(result))
+    {
+        const double cleanupEnd = Platform::GetTimeSeconds() + XBOX_LIVE_CLEANUP_TIMEOUT;
+        while ((result = XAsyncGetStatus(&cleanupBlock, false)) == E_PENDING && Platform::GetTimeSeconds() < cleanupEnd)
+        {
+            if (!Worker)
+                XblDispatch(_taskQueue);
+            Platform::Sleep(1);
+        }
+        if (result == E_PENDING)
+            LOG(Warning, "Xbox Live cleanup didn't end in time");
+        else
+            XBOX_LIVE_LOG("XblCleanupAsync");
+    }
+    if (Worker)
+    {
+        Worker->Stop();
+        Worker->WorkerThread->Join();
+        Delete(Worker->WorkerThread);
+        Delete(Worker);
+        Worker = nullptr;
+    }
+    if (_completions)
+    {
+        ProcessCompletions();
+        Delete(_completions);
+        _completions = nullptr;
+    }
     if (_taskQueue)
     {
+        if (_taskQueueMonitorToken != 0)
+        {
+            XTaskQueueUnregisterMonitor(_taskQueue, { _taskQueueMonitorToken });
+            _taskQueueMonitorToken = 0;
+        }
         XTaskQueueCloseHandle(_taskQueue);
         _taskQueue = nullptr;
     }
+    if (XboxLiveAllocator::Release())
+        LOG(Info, "Xbox Live SDK memory is still in use ({0} bytes) after cleanup", XboxLiveAllocator::GetLiveBytes());
+    ActivePlatform = nullptr;
 }
 
 bool OnlinePlatformXboxLive::UserLogin(User* localUser)
 {
-    if (Platform::Users.Count() == 0)
-        return true;
     if (!localUser)
+    {
+        if (Platform::Users.Count() == 0)
+            return true;
         localUser = Platform::Users.First();
+    }
     if (_users.ContainsKey(localUser))
         return false;
     XblContextHandle context;
-    HRESULT result = XblContextCreateHandle(localUser->UserHandle, &context);
+    HRESULT result = Backend->ContextCreateHandle(localUser->UserHandle, &context);
     XBOX_LIVE_CHECK_RETURN("XblContextCreateHandle");
     _users[localUser] = context;
+    RegisterLocalUser(localUser);
     return false;
 }
 
 bool OnlinePlatformXboxLive::UserLogout(User* localUser)
 {
-    if (Platform::Users.Count() == 0)
-        return true;
     if (!localUser)
+    {
+        if (Platform::Users.Count() == 0)
+            return true;
         localUser = Platform::Users.First();
+    }
     XblContextHandle context;
     if (_users.TryGet(localUser, context))
     {
+        ClosePresenceSubscription(localUser);
+        XblUserStats* stats;
+        if (_stats.TryGet(localUser, stats))
+        {
+            FlushUserStats(localUser, stats);
+            Delete(stats);
+            _stats.Remove(localUser);
+        }
+        XblUserPresence* presence;
+        if (_richPresence.TryGet(localUser, presence))
+        {
+            Delete(presence);
+            _richPresence.Remove(localUser);
+        }
+        DrainOperations(localUser);
+        ReleaseSignOutDeferral(localUser);
         if (const XGameSaveProviderHandle* provider = _gameSaveProviders.TryGet(localUser))
         {
-            XGameSaveCloseProvider(*provider);
+            Backend->GameSaveCloseProvider(*provider);
             _gameSaveProviders.Remove(localUser);
         }
-        XblContextCloseHandle(context);
+        Backend->ContextCloseHandle(context);
         _users.Remove(localUser);
+        UnregisterLocalUser(localUser);
     }
     return false;
 }
@@ -573,26 +2169,31 @@ bool OnlinePlatformXboxLive::GetUser(OnlineUser& user, User* localUser)
     if (GetContext(localUser, context))
     {
         uint64_t xboxUserId;
-        XblContextGetXboxUserId(context, &xboxUserId);
+        Backend->ContextGetXboxUserId(context, &xboxUserId);
         user.Id = GetUserId(xboxUserId);
 
         char gamerTag[XUserGamertagComponentModernMaxBytes];
         size_t gamerTagSize;
-        XUserGetGamertag(localUser->UserHandle, XUserGamertagComponent::Modern, ARRAY_COUNT(gamerTag), gamerTag, &gamerTagSize);
-        user.Name.SetUTF8(gamerTag, StringUtils::Length(gamerTag));
+        Backend->UserGetGamertag(localUser->UserHandle, XUserGamertagComponent::Modern, ARRAY_COUNT(gamerTag), gamerTag, &gamerTagSize);
+        ProfileCache.Set(xboxUserId, gamerTag, user.Name);
 
+        // Use the cached presence (kept up to date by the presence subscription)
+        if (_presence.TryGet(xboxUserId, user.PresenceState))
+            return false;
         XblPresenceContext presenceContext;
         presenceContext.Presence = OnlinePresenceStates::Online;
         XAsyncBlock ab;
         ab.queue = _taskQueue;
         ab.callback = OnGetPresence;
         ab.context = &presenceContext;
-        HRESULT result = XblPresenceGetPresenceAsync(context, xboxUserId, &ab);
-        if (SUCCEEDED(result))
-            XblSyncWait(presenceContext, _taskQueue);
-        else
-            XBOX_LIVE_LOG("XblPresenceGetPresenceAsync");
+        const bool failed = XblSyncCall(*this, XblService::Presence, localUser, presenceContext, ab, _taskQueue, TEXT("XblPresenceGetPresenceAsync"), [&](XAsyncBlock* async)
+        {
+            return XblPresenceGetPresenceAsync(context, xboxUserId, async);
+        });
+        if (!failed && _presenceRefs.ContainsKey(xboxUserId))
+            _presence[xboxUserId] = presenceContext.Presence;
         user.PresenceState = presenceContext.Presence;
+        return false;
     }
     return true;
 }
@@ -604,28 +2205,49 @@ bool OnlinePlatformXboxLive::GetFriends(Array<OnlineUser>& friends, User* localU
     {
         // Query friends list (only IDs)
         uint64_t xboxUserId;
-        XblContextGetXboxUserId(context, &xboxUserId);
+        Backend->ContextGetXboxUserId(context, &xboxUserId);
         XblFriendsContext friendsContext;
         friendsContext.Context = context;
+        friendsContext.XboxUserId = xboxUserId;
         friendsContext.Friends = &friends;
         XAsyncBlock ab;
         ab.queue = _taskQueue;
         ab.callback = OnGetFriendsIds;
         ab.context = &friendsContext;
-        HRESULT result = XblSocialGetSocialRelationshipsAsync(context, xboxUserId, XblSocialRelationshipFilter::All, 0, 0, &ab);
-        XBOX_LIVE_CHECK_RETURN("XblSocialGetSocialRelationshipsAsync");
-        if (XblSyncWait(friendsContext, _taskQueue))
+        const bool failed = XblSyncCall(*this, XblService::Social, localUser, friendsContext, ab, _taskQueue, TEXT("XblSocialGetSocialRelationshipsAsync"), [&](XAsyncBlock* async)
+        {
+            return friendsContext.Start(async);
+        });
+        if (failed)
             return true;
 
         // No friends, nobody likes you
         if (friendsContext.FriendsIds.IsEmpty())
             return false;
 
-        // Query info for all friends
+        // Use cached profiles and query info only for the remaining friends
+        const double minTime = Platform::GetTimeSeconds() - XBOX_LIVE_PROFILE_CACHE_TTL;
+        friends.Resize(friendsContext.FriendsIds.Count());
+        for (int32 i = 0; i < friendsContext.FriendsIds.Count(); i++)
+        {
+            const uint64 friendId = friendsContext.FriendsIds[i];
+            OnlineUser& f = friends[i];
+            f.Id = GetUserId(friendId);
+            if (!_presence.TryGet(friendId, f.PresenceState))
+                f.PresenceState = OnlinePresenceStates::Online;
+            if (!ProfileCache.TryGetName(friendId, minTime, f.Name))
+            {
+                friendsContext.ProfilesLookup.Add(friendId, i);
+                friendsContext.ProfilesIds.Add(friendId);
+            }
+        }
+        if (friendsContext.ProfilesIds.IsEmpty())
+            return false;
         ab.callback = OnGetFriendsProfiles;
-        result = XblProfileGetUserProfilesAsync(context, friendsContext.FriendsIds.Get(), friendsContext.FriendsIds.Count(), &ab);
-        XBOX_LIVE_CHECK_RETURN("XblProfileGetUserProfilesAsync");
-        return XblSyncWait(friendsContext, _taskQueue);
+        return XblSyncCall(*this, XblService::Social, localUser, friendsContext, ab, _taskQueue, TEXT("XblProfileGetUserProfilesAsync"), [&](XAsyncBlock* async)
+        {
+            return Backend->ProfileGetUserProfilesAsync(context, friendsContext.ProfilesIds.Get(), friendsContext.ProfilesIds.Count(), async);
+        });
     }
     return true;
 }
@@ -636,16 +2258,20 @@ bool OnlinePlatformXboxLive::GetAchievements(Array<OnlineAchievement>& achieveme
     if (GetContext(localUser, context))
     {
         uint64_t xboxUserId;
-        XblContextGetXboxUserId(context, &xboxUserId);
+        Backend->ContextGetXboxUserId(context, &xboxUserId);
         XblAchievementsContext achievementsContext;
+        achievementsContext.Context = context;
+        achievementsContext.XboxUserId = xboxUserId;
+        achievementsContext.TitleId = _titleId;
         achievementsContext.Achievements = &achievements;
         XAsyncBlock ab;
         ab.queue = _taskQueue;
         ab.callback = OnGetAchievements;
         ab.context = &achievementsContext;
-        HRESULT result = XblAchievementsGetAchievementsForTitleIdAsync(context, xboxUserId, _titleId, XblAchievementType::All, false, XblAchievementOrderBy::DefaultOrder, 0, 0, &ab);
-        XBOX_LIVE_CHECK_RETURN("XblAchievementsGetAchievementsForTitleIdAsync");
-        return XblSyncWait(achievementsContext, _taskQueue);
+        return XblSyncCall(*this, XblService::Achievements, localUser, achievementsContext, ab, _taskQueue, TEXT("XblAchievementsGetAchievementsForTitleIdAsync"), [&](XAsyncBlock* async)
+        {
+            return achievementsContext.Start(async);
+        });
     }
     return true;
 }
@@ -661,15 +2287,29 @@ bool OnlinePlatformXboxLive::UnlockAchievementProgress(const StringView& name, f
     if (GetContext(localUser, context))
     {
         uint64_t xboxUserId;
-        XblContextGetXboxUserId(context, &xboxUserId);
+        Backend->ContextGetXboxUserId(context, &xboxUserId);
+        if (XblIsServiceDown(XblService::Achievements, CircuitBreakerCooldown))
+            return true;
         const StringAsANSI<> nameStr(name.Get(), name.Length());
-        XAsyncBlock ab;
-        ab.queue = _taskQueue;
-        ab.callback = nullptr;
-        HRESULT result = XblAchievementsUpdateAchievementAsync(context, xboxUserId, nameStr.Get(), (uint32_t)progress, &ab);
-        if (result == HTTP_E_STATUS_NOT_MODIFIED)
-            return false;
+
+        // Send update in the background (result is checked once the task ends)
+        auto update = New<XblAchievementUpdateContext>();
+        update->Operation.LocalUser = localUser;
+        update->Completions = _completions;
+        update->Async.queue = _taskQueue;
+        update->Async.callback = OnUpdateAchievement;
+        update->Async.context = update;
+        HRESULT result = XblAchievementsUpdateAchievementAsync(context, xboxUserId, nameStr.Get(), (uint32_t)progress, &update->Async);
+        if (FAILED(result))
+        {
+            Delete(update);
+            XblReportService(XblService::Achievements, result == HTTP_E_STATUS_NOT_MODIFIED ? S_OK : result, CircuitBreakerThreshold);
+            if (result == HTTP_E_STATUS_NOT_MODIFIED)
+                return false;
+        }
         XBOX_LIVE_CHECK_RETURN("XblAchievementsUpdateAchievementAsync");
+        XblTrackOperation(update->Operation, &update->Async);
+        _backgroundTasks++;
         return false;
     }
     return true;
@@ -688,23 +2328,43 @@ bool OnlinePlatformXboxLive::ResetAchievements(User* localUser)
 
 bool OnlinePlatformXboxLive::GetStat(const StringView& name, float& value, User* localUser)
 {
+    XboxLiveStatValue statValue;
+    if (GetStatValue(name, statValue, localUser))
+        return true;
+    value = XblGetStatFloat(statValue);
+    return false;
+}
+
+bool OnlinePlatformXboxLive::GetStatValue(const StringView& name, XboxLiveStatValue& value, User* localUser)
+{
+    bool exists;
+    return ReadStat(name, value, exists, localUser) || !exists;
+}
+
+bool OnlinePlatformXboxLive::ReadStat(const StringView& name, XboxLiveStatValue& value, bool& exists, User* localUser)
+{
+    exists = false;
     XblContextHandle context;
     if (GetContext(localUser, context))
     {
         uint64_t xboxUserId;
-        XblContextGetXboxUserId(context, &xboxUserId);
+        Backend->ContextGetXboxUserId(context, &xboxUserId);
         XblStatsContext statsContext;
-        statsContext.Value = value;
         XAsyncBlock ab;
         ab.queue = _taskQueue;
         ab.callback = OnGetStat;
         ab.context = &statsContext;
         const char* scid = nullptr;
-        XblGetScid(&scid);
+        Backend->GetScid(&scid);
         const StringAsANSI<> nameStr(name.Get(), name.Length());
-        HRESULT result = XblUserStatisticsGetSingleUserStatisticAsync(context, xboxUserId, scid, nameStr.Get(), &ab);
-        XBOX_LIVE_CHECK_RETURN("XblUserStatisticsGetSingleUserStatisticAsync");
-        return XblSyncWait(statsContext, _taskQueue);
+        if (XblSyncCall(*this, XblService::Stats, localUser, statsContext, ab, _taskQueue, TEXT("XblUserStatisticsGetSingleUserStatisticAsync"), [&](XAsyncBlock* async)
+        {
+            return XblUserStatisticsGetSingleUserStatisticAsync(context, xboxUserId, scid, nameStr.Get(), async);
+        }))
+            return true;
+        exists = statsContext.Exists;
+        value = statsContext.Value;
+        return false;
     }
     return true;
 }
@@ -714,17 +2374,9 @@ bool OnlinePlatformXboxLive::SetStat(const StringView& name, float value, User*
     XblContextHandle context;
     if (GetContext(localUser, context))
     {
-        XAsyncBlock ab;
-        ab.queue = _taskQueue;
-        ab.callback = nullptr;
+        // Stats are sent in batches (see FlushStats)
         const StringAsANSI<> nameStr(name.Get(), name.Length());
-        XblTitleManagedStatistic statistic;
-        statistic.statisticName = nameStr.Get();
-        statistic.statisticType = XblTitleManagedStatType::Number;
-        statistic.numberValue = (double)value;
-        statistic.stringValue = nullptr;
-        HRESULT result = XblTitleManagedStatsUpdateStatsAsync(context, &statistic, 1, &ab);
-        XBOX_LIVE_CHECK_RETURN("XblTitleManagedStatsUpdateStatsAsync");
+        GetUserStats(localUser)->SetStat(StringAnsiView(nameStr.Get()), (double)value);
         return false;
     }
     return true;
@@ -735,8 +2387,25 @@ bool OnlinePlatformXboxLive::GetLeaderboard(const StringView& name, OnlineLeader
     XblContextHandle context;
     if (GetContext(localUser, context))
     {
-        value.Identifier = String::Format(TEXT("{}|{}"), name, (uintptr)localUser);
-        // TODO: fetch leaderboards metadata
+        XblLeaderboardInfo* info = GetLeaderboardInfo(name, localUser);
+        if (!info->HasMetadata)
+        {
+            // Query a single row to get the leaderboard metadata
+            XblLeaderboardsContext leaderboardContext;
+            leaderboardContext.LocalUser = localUser;
+            leaderboardContext.Context = context;
+            leaderboardContext.Info = info;
+            leaderboardContext.Query = info->Query;
+            leaderboardContext.Query.maxItems = 1;
+            leaderboardContext.Entries = &Scratch.Entries;
+            if (GetLeaderboardEntries(leaderboardContext))
+                return true;
+        }
+        value.Identifier = info->Identifier;
+        value.Name = name;
+        value.SortMode = OnlineLeaderboardSortModes::Descending;
+        value.ValueFormat = info->ValueFormat;
+        value.EntriesCount = info->TotalCount;
         return false;
     }
     return true;
@@ -745,7 +2414,11 @@ bool OnlinePlatformXboxLive::GetLeaderboard(const StringView& name, OnlineLeader
 bool OnlinePlatformXboxLive::GetOrCreateLeaderboard(const StringView& name, OnlineLeaderboardSortModes sortMode, OnlineLeaderboardValueFormats valueFormat, OnlineLeaderboard& value, User* localUser)
 {
     // Creating leaderboards is not supported from game
-    return GetLeaderboard(name, value, localUser);
+    if (GetLeaderboard(name, value, localUser))
+        return true;
+    value.SortMode = sortMode;
+    value.ValueFormat = valueFormat;
+    return false;
 }
 
 bool OnlinePlatformXboxLive::GetLeaderboardEntries(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries, int32 start, int32 count)
@@ -753,9 +2426,24 @@ bool OnlinePlatformXboxLive::GetLeaderboardEntries(const OnlineLeaderboard& lead
     XblLeaderboardsContext context;
     if (GetLeaderboardContext(leaderboard, context))
     {
+        // Try to use cached rows
+        XblLeaderboardCache* cache = GetLeaderboardCache(context.Info, start + count);
+        if (cache && cache->HasRows(start, count, Platform::GetTimeSeconds() - LeaderboardCacheTTL))
+        {
+            cache->GetRows(start, count, entries);
+            PrefetchLeaderboardEntries(context, cache, start + count, count);
+            return false;
+        }
+
         context.Query.skipResultToRank = start;
         context.Query.maxItems = count;
-        return GetLeaderboardEntries(context);
+        context.Entries = &entries;
+        context.Cache = cache;
+        context.CacheStart = start;
+        if (GetLeaderboardEntries(context))
+            return true;
+        PrefetchLeaderboardEntries(context, cache, start + count, count);
+        return false;
     }
     return true;
 }
@@ -766,9 +2454,10 @@ bool OnlinePlatformXboxLive::GetLeaderboardEntriesAroundUser(const OnlineLeaderb
     if (GetLeaderboardContext(leaderboard, context))
     {
         uint64_t xboxUserId;
-        XblContextGetXboxUserId(context.Context, &xboxUserId);
+        Backend->ContextGetXboxUserId(context.Context, &xboxUserId);
         context.Query.skipToXboxUserId = xboxUserId;
         context.Query.maxItems = count;
+        context.Entries = &entries;
         if (start != 0)
             LOG(Warning, "Xbox Live doesn't support reading leaderboard entries before the player (only after).");
         return GetLeaderboardEntries(context);
@@ -782,6 +2471,7 @@ bool OnlinePlatformXboxLive::GetLeaderboardEntriesForFriends(const OnlineLeaderb
     if (GetLeaderboardContext(leaderboard, context))
     {
         context.Query.socialGroup = XblSocialGroupType::People;
+        context.Entries = &entries;
         return GetLeaderboardEntries(context);
     }
     return true;
@@ -792,7 +2482,7 @@ bool OnlinePlatformXboxLive::GetLeaderboardEntriesForUsers(const OnlineLeaderboa
     XblLeaderboardsContext context;
     if (GetLeaderboardContext(leaderboard, context))
     {
-        Array<OnlineLeaderboardEntry> tmp;
+        auto& tmp = Scratch.Entries;
         entries.Resize(users.Count());
         for (int32 i = 0; i < users.Count(); i++)
         {
@@ -801,22 +2491,302 @@ bool OnlinePlatformXboxLive::GetLeaderboardEntriesForUsers(const OnlineLeaderboa
             context.Entries = &tmp;
             if (GetLeaderboardEntries(context))
                 return true;
-            entries[i] = tmp.HasItems() ? tmp[0] : OnlineLeaderboardEntry();
-            tmp.Clear();
+            if (tmp.HasItems())
+                entries[i] = MoveTemp(tmp[0]);
+            else
+                entries[i] = OnlineLeaderboardEntry();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool OnlinePlatformXboxLive::SubscribePresence(const Array<Guid, HeapAllocation>& users, User* localUser)
+{
+    XblContextHandle context;
+    if (GetContext(localUser, context))
+    {
+        PROFILE_CPU();
+        int32 start;
+        XblPresenceSubscription* subscription = TrackPresence(users, localUser, context, start);
+        if (!subscription)
+            return true;
+        const uint64* newUsers = subscription->Users.Get() + start;
+        const int32 trackCount = subscription->Users.Count() - start;
+        if (trackCount == 0)
+            return false;
+
+        // Get the initial presence of the tracked users
+        XblPresenceUsersContext presenceContext;
+        presenceContext.Presence = &_presence;
+        XAsyncBlock ab;
+        ab.queue = _taskQueue;
+        ab.callback = OnGetPresenceForUsers;
+        ab.context = &presenceContext;
+        return XblSyncCall(*this, XblService::Presence, localUser, presenceContext, ab, _taskQueue, TEXT("XblPresenceGetPresenceForMultipleUsersAsync"), [&](XAsyncBlock* async)
+        {
+            return XblPresenceGetPresenceForMultipleUsersAsync(context, newUsers, trackCount, nullptr, async);
+        });
+    }
+    return true;
+}
+
+bool OnlinePlatformXboxLive::UnsubscribePresence(const Array<Guid, HeapAllocation>& users, User* localUser)
+{
+    XblContextHandle context;
+    XblPresenceSubscription* subscription;
+    if (GetContext(localUser, context) && _presenceSubscriptions.TryGet(localUser, subscription))
+    {
+        Array<uint64> removed;
+        for (const Guid& userId : users)
+        {
+            const uint64 xboxUserId = GetXboxUserId(userId);
+            if (xboxUserId != subscription->Users[0] && subscription->Users.Remove(xboxUserId))
+            {
+                removed.Add(xboxUserId);
+                ReleasePresence(xboxUserId);
+            }
+        }
+        if (removed.HasItems())
+        {
+            HRESULT result = XblPresenceStopTrackingUsers(context, removed.Get(), removed.Count());
+            XBOX_LIVE_CHECK_RETURN("XblPresenceStopTrackingUsers");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool OnlinePlatformXboxLive::SetPresence(const StringView& presenceId, const Array<String, HeapAllocation>& tokens, bool active, User* localUser)
+{
+    XblContextHandle context;
+    if (GetContext(localUser, context))
+    {
+        XblUserPresence* presence;
+        if (!_richPresence.TryGet(localUser, presence))
+        {
+            presence = New<XblUserPresence>();
+            _richPresence.Add(localUser, presence);
+        }
+
+        // Update the latest presence (sent with FlushPresence unless it's the same as in the service)
+        XblRichPresence& current = presence->Current;
+        current.Active = active;
+        current.Id.Set(presenceId.Get(), presenceId.Length());
+        current.Tokens.Resize(tokens.Count());
+        for (int32 i = 0; i < tokens.Count(); i++)
+            current.Tokens[i].Set(tokens[i].Get(), tokens[i].Length());
+        return false;
+    }
+    return true;
+}
+
+bool OnlinePlatformXboxLive::GetPresence(const Guid& userId, OnlinePresenceStates& state) const
+{
+    return !_presence.TryGet(GetXboxUserId(userId), state);
+}
+
+bool OnlinePlatformXboxLive::GetAchievementsForTitles(const Array<uint32, HeapAllocation>& titleIds, Array<XboxLiveTitleAchievement, HeapAllocation>& achievements, User* localUser)
+{
+    XblContextHandle context;
+    if (GetContext(localUser, context))
+    {
+        PROFILE_CPU();
+        uint64_t xboxUserId;
+        Backend->ContextGetXboxUserId(context, &xboxUserId);
+
+        // Send queries for all titles at once (total time is a single round-trip instead of one per title)
+        Array<XblTitleAchievementsContext> contexts;
+        contexts.Resize(titleIds.Count());
+        for (int32 i = 0; i < titleIds.Count(); i++)
+        {
+            XblTitleAchievementsContext& titleContext = contexts[i];
+            titleContext.Context = context;
+            titleContext.XboxUserId = xboxUserId;
+            titleContext.TitleId = titleIds[i];
+            titleContext.Achievements = &titleContext.Results;
+            titleContext.Async.queue = _taskQueue;
+            titleContext.Async.callback = OnGetAchievements;
+            titleContext.Async.context = &titleContext;
+        }
+        XblSyncCallBatch(*this, XblService::Achievements, localUser, contexts, _taskQueue, TEXT("XblAchievementsGetAchievementsForTitleIdAsync"));
+
+        // Merge results
+        bool failed = titleIds.HasItems();
+        achievements.Clear();
+        for (XblTitleAchievementsContext& titleContext : contexts)
+        {
+            if (FAILED(titleContext.Result))
+                continue;
+            failed = false;
+            for (OnlineAchievement& achievement : titleContext.Results)
+            {
+                XboxLiveTitleAchievement& e = achievements.AddOne();
+                e.TitleId = titleContext.TitleId;
+                e.Achievement = MoveTemp(achievement);
+            }
+        }
+        return failed;
+    }
+    return true;
+}
+
+bool OnlinePlatformXboxLive::GetStatsForServices(const Array<String, HeapAllocation>& scids, const Array<String, HeapAllocation>& names, Array<XboxLiveServiceStat, HeapAllocation>& stats, User* localUser)
+{
+    XblContextHandle context;
+    if (GetContext(localUser, context))
+    {
+        PROFILE_CPU();
+        uint64_t xboxUserId;
+        Backend->ContextGetXboxUserId(context, &xboxUserId);
+        Array<StringAnsi> namesAnsi;
+        Array<const char*> namesPtrs;
+        namesAnsi.Resize(names.Count());
+        namesPtrs.Resize(names.Count());
+        for (int32 i = 0; i < names.Count(); i++)
+        {
+            namesAnsi[i] = StringAnsi(names[i]);
+            namesPtrs[i] = namesAnsi[i].Get();
+        }
+
+        // Send queries for all services at once (total time is a single round-trip instead of one per service)
+        Array<XblServiceStatsContext> contexts;
+        contexts.Resize(scids.Count());
+        for (int32 i = 0; i < scids.Count(); i++)
+        {
+            XblServiceStatsContext& statsContext = contexts[i];
+            statsContext.Context = context;
+            statsContext.XboxUserId = xboxUserId;
+            statsContext.Scid = scids[i];
+            statsContext.Names = namesPtrs.Get();
+            statsContext.NamesCount = namesPtrs.Count();
+            statsContext.Async.queue = _taskQueue;
+            statsContext.Async.callback = OnGetServiceStats;
+            statsContext.Async.context = &statsContext;
+        }
+        XblSyncCallBatch(*this, XblService::Stats, localUser, contexts, _taskQueue, TEXT("XblUserStatisticsGetMultipleUserStatisticsAsync"));
+
+        // Merge results
+        bool failed = scids.HasItems();
+        stats.Clear();
+        for (XblServiceStatsContext& statsContext : contexts)
+        {
+            if (FAILED(statsContext.Result))
+                continue;
+            failed = false;
+            for (XboxLiveServiceStat& stat : statsContext.Results)
+                stats.Add(MoveTemp(stat));
+        }
+        return failed;
+    }
+    return true;
+}
+
+XboxLiveMemoryStats OnlinePlatformXboxLive::GetMemoryStats() const
+{
+    XboxLiveMemoryStats stats;
+    stats.LiveBytes = XboxLiveAllocator::GetLiveBytes();
+    stats.PeakBytes = XboxLiveAllocator::GetPeakBytes();
+    stats.ReservedBytes = XboxLiveAllocator::GetReservedBytes();
+    stats.Allocations = XboxLiveAllocator::GetAllocations();
+    stats.ScratchAllocations = Platform::AtomicRead(&XblScratch::Allocations);
+    return stats;
+}
+
+int64 OnlinePlatformXboxLive::GetMemoryUsage(int32 memoryType) const
+{
+    return memoryType >= 0 ? XboxLiveAllocator::GetLiveBytes((uint32)memoryType) : 0;
+}
+
+int64 OnlinePlatformXboxLive::GetMemoryBudget() const
+{
+    return XboxLiveAllocator::GetBudget();
+}
+
+void OnlinePlatformXboxLive::SetMemoryBudget(int64 value)
+{
+    XboxLiveAllocator::SetBudget(value);
+}
+
+int64 OnlinePlatformXboxLive::GetProfileCacheBudget() const
+{
+    return ProfileCache.MemoryBudget;
+}
+
+void OnlinePlatformXboxLive::SetProfileCacheBudget(int64 value)
+{
+    ProfileCache.MemoryBudget = Math::Max<int64>(value, 0);
+}
+
+bool OnlinePlatformXboxLive::GetUserAvatarUrl(const Guid& userId, String& url) const
+{
+    return !ProfileCache.TryGetAvatarUrl(GetXboxUserId(userId), url);
+}
+
+void OnlinePlatformXboxLive::FlushStats()
+{
+    for (auto& e : _stats)
+        FlushUserStats(e.Key, e.Value);
+    _statsFlushTime = Platform::GetTimeSeconds();
+}
+
+void OnlinePlatformXboxLive::CancelOperations(User* localUser)
+{
+    PROFILE_CPU();
+    ScopeLock lock(OperationsLocker);
+    for (XblOperation* operation : Operations)
+    {
+        if (localUser && operation->LocalUser != localUser)
+            continue;
+        operation->Canceled = true;
+        if (operation->Async)
+            XAsyncCancel(operation->Async);
+    }
+}
+
+void OnlinePlatformXboxLive::ClearLeaderboardCache()
+{
+    for (auto& e : _leaderboardCaches)
+        e.Value->Clear();
+}
+
+bool OnlinePlatformXboxLive::SetLeaderboardEntry(const OnlineLeaderboard& leaderboard, int32 score, bool keepBest)
+{
+    XblLeaderboardsContext context;
+    if (GetLeaderboardContext(leaderboard, context))
+    {
+        // Leaderboards are backed by title-managed stats of the same name
+        XblUserStats* stats = GetUserStats(context.LocalUser);
+        if (keepBest)
+        {
+            int32 best;
+            if (!stats->BestScores.TryGet(context.Info->Name, best))
+            {
+                // Read the current score once to know the best one (don't overwrite it if it's unknown)
+                XboxLiveStatValue value;
+                bool exists;
+                if (ReadStat(String(context.Info->Name), value, exists, context.LocalUser))
+                    return true;
+                if (!exists)
+                    best = leaderboard.SortMode == OnlineLeaderboardSortModes::Ascending ? MAX_int32 : MIN_int32;
+                else if (value.Type == XboxLiveStatTypes::Double)
+                    best = (int32)Math::Clamp(value.DoubleValue, (double)MIN_int32, (double)MAX_int32);
+                else
+                    best = (int32)Math::Clamp(value.IntValue, (int64)MIN_int32, (int64)MAX_int32);
+                stats->BestScores[context.Info->Name] = best;
+            }
+            const bool improved = leaderboard.SortMode == OnlineLeaderboardSortModes::Ascending ? score < best : score > best;
+            if (!improved)
+                return false;
         }
+        // Pending score is the baseline for the next submissions until it's sent (it's forgotten if the service rejects it, see XblUserStats::Restore)
+        stats->BestScores[context.Info->Name] = score;
+        stats->SetStat(context.Info->Name, (double)score);
         return false;
     }
     return true;
 }
 
-bool OnlinePlatformXboxLive::SetLeaderboardEntry(const OnlineLeaderboard& leaderboard, int32 score, bool keepBest)
-{
-#if !BUILD_RELEASE
-    LOG(Warning, "OnlinePlatformXboxLive::SetLeaderboardEntry is not supported");
-#endif
-    return true;
-}
-
 bool OnlinePlatformXboxLive::GetSaveGame(const StringView& name, Array<byte>& data, User* localUser)
 {
     PROFILE_CPU();
@@ -828,7 +2798,7 @@ bool OnlinePlatformXboxLive::GetSaveGame(const StringView& name, Array<byte>& da
 
         // Check if savegame exists
         bool exists = false;
-        HRESULT result = XGameSaveGetContainerInfo(provider, containerName.Get(), &exists, [](const XGameSaveContainerInfo* containerInfo, void* context)
+        HRESULT result = Backend->GameSaveGetContainerInfo(provider, containerName.Get(), &exists, [](const XGameSaveContainerInfo* containerInfo, void* context)
         {
             *(bool*)context = true;
             return true;
@@ -838,13 +2808,13 @@ bool OnlinePlatformXboxLive::GetSaveGame(const StringView& name, Array<byte>& da
         {
             // Get container
             XGameSaveContainerHandle container = nullptr;
-            result = XGameSaveCreateContainer(provider, containerName.Get(), &container);
+            result = Backend->GameSaveCreateContainer(provider, containerName.Get(), &container);
             XBOX_LIVE_LOG("XGameSaveCreateContainer");
             if (SUCCEEDED(result))
             {
                 // Find blob size
                 int32 blobSize = 0;
-                result = XGameSaveEnumerateBlobInfo(container, &blobSize, [](const XGameSaveBlobInfo* blobInfo, void* context)
+                result = Backend->GameSaveEnumerateBlobInfo(container, &blobSize, [](const XGameSaveBlobInfo* blobInfo, void* context)
                 {
                     if (StringAnsiView(blobInfo->name) == XBOX_LIVE_SAVE_GAME_BLOB_NAME)
                     {
@@ -861,7 +2831,7 @@ bool OnlinePlatformXboxLive::GetSaveGame(const StringView& name, Array<byte>& da
                     uint32_t blobCount = 1;
                     uint32_t blobsSize = sizeof(XGameSaveBlob) + StringUtils::Length(XBOX_LIVE_SAVE_GAME_BLOB_NAME) + 1 + blobSize;
                     XGameSaveBlob* blobs = (XGameSaveBlob*)Allocator::Allocate(blobsSize);
-                    result = XGameSaveReadBlobData(container, blobNames, &blobCount, blobsSize, blobs);
+                    result = Backend->GameSaveReadBlobData(container, blobNames, &blobCount, blobsSize, blobs);
                     XBOX_LIVE_LOG("XGameSaveReadBlobData");
                     if (SUCCEEDED(result))
                     {
@@ -870,7 +2840,7 @@ bool OnlinePlatformXboxLive::GetSaveGame(const StringView& name, Array<byte>& da
                     }
                     Allocator::Free(blobs);
                 }
-                XGameSaveCloseContainer(container);
+                Backend->GameSaveCloseContainer(container);
             }
         }
         return false;
@@ -888,40 +2858,40 @@ bool OnlinePlatformXboxLive::SetSaveGame(const StringView& name, const Span<byte
 
         // Get or create container
         XGameSaveContainerHandle container = nullptr;
-        HRESULT result = XGameSaveCreateContainer(provider, containerName.Get(), &container);
+        HRESULT result = Backend->GameSaveCreateContainer(provider, containerName.Get(), &container);
         XBOX_LIVE_LOG("XGameSaveCreateContainer");
 
         // Submit or delete blob
         XGameSaveUpdateHandle update = nullptr;
         if (SUCCEEDED(result))
         {
-            result = XGameSaveCreateUpdate(container, containerName.Get(), &update);
+            result = Backend->GameSaveCreateUpdate(container, containerName.Get(), &update);
             XBOX_LIVE_LOG("XGameSaveCreateUpdate");
         }
         if (SUCCEEDED(result))
         {
             if (data.Length() > 0)
             {
-                result = XGameSaveSubmitBlobWrite(update, XBOX_LIVE_SAVE_GAME_BLOB_NAME, data.Get(), data.Length());
+                result = Backend->GameSaveSubmitBlobWrite(update, XBOX_LIVE_SAVE_GAME_BLOB_NAME, data.Get(), data.Length());
                 XBOX_LIVE_LOG("XGameSaveSubmitBlobWrite");
             }
             else
             {
-                result = XGameSaveSubmitBlobDelete(update, XBOX_LIVE_SAVE_GAME_BLOB_NAME);
+                result = Backend->GameSaveSubmitBlobDelete(update, XBOX_LIVE_SAVE_GAME_BLOB_NAME);
                 XBOX_LIVE_LOG("XGameSaveSubmitBlobDelete");
             }
         }
         if (SUCCEEDED(result))
         {
-            result = XGameSaveSubmitUpdate(update);
+            result = Backend->GameSaveSubmitUpdate(update);
             XBOX_LIVE_LOG("XGameSaveSubmitUpdate");
         }
 
         // Finalize
         if (update)
-            XGameSaveCloseUpdate(update);
+            Backend->GameSaveCloseUpdate(update);
         if (container)
-            XGameSaveCloseContainer(container);
+            Backend->GameSaveCloseContainer(container);
         return FAILED(result);
     }
     return true;
@@ -929,55 +2899,69 @@ bool OnlinePlatformXboxLive::SetSaveGame(const StringView& name, const Span<byte
 
 bool OnlinePlatformXboxLive::GetSaveGameProvider(User*& localUser, XGameSaveProvider*& provider)
 {
-    if (Platform::Users.Count() == 0)
-        return false;
     if (!localUser)
+    {
+        if (Platform::Users.Count() == 0)
+            return false;
         localUser = Platform::Users.First();
+    }
     if (_gameSaveProviders.TryGet(localUser, provider))
         return true;
 
     // Initialize gamesave provider for this user
     const char* scid = nullptr;
-    XblGetScid(&scid);
-    XAsyncBlock ab;
+    Backend->GetScid(&scid);
+    XAsyncBlock ab = {};
     ab.queue = _taskQueue;
     ab.callback = nullptr;
-    HRESULT result = XGameSaveInitializeProviderAsync(localUser->UserHandle, scid, true, &ab);
-    XBOX_LIVE_CHECK_RETURN("XGameSaveInitializeProviderAsync");
-    if (SUCCEEDED(result) && !XblSyncWait(ab, _taskQueue))
+    XblOperation operation;
+    operation.LocalUser = localUser;
+    HRESULT result = Backend->GameSaveInitializeProviderAsync(localUser->UserHandle, scid, true, &ab);
+    XBOX_LIVE_LOG("XGameSaveInitializeProviderAsync");
+    if (FAILED(result))
+        return false;
+    XblTrackOperation(operation, &ab);
+    const bool failed = XblSyncWait(ab, _taskQueue, operation, XblGetDeadline(*this));
+    XblUntrackOperation(operation);
+    XblTraceCall(TEXT("XGameSaveInitializeProviderAsync"), operation.StartTime, XAsyncGetStatus(&ab, false));
+    if (!failed)
     {
-        result = XGameSaveInitializeProviderResult(&ab, &provider);
-        XBOX_LIVE_CHECK_RETURN("XGameSaveInitializeProviderResult");
+        result = Backend->GameSaveInitializeProviderResult(&ab, &provider);
+        XBOX_LIVE_LOG("XGameSaveInitializeProviderResult");
         if (SUCCEEDED(result))
         {
             // Cache provider for this user
             _gameSaveProviders.Add(localUser, provider);
+            RegisterLocalUser(localUser);
             return true;
         }
     }
+    else if (XAsyncGetStatus(&ab, false) == E_ABORT && !XblIsCanceled(operation))
+    {
+        LOG(Warning, "Xbox Live method {0} timed out", TEXT("XGameSaveInitializeProviderAsync"));
+    }
 
     return false;
 }
 
 bool OnlinePlatformXboxLive::GetLeaderboardContext(const OnlineLeaderboard& leaderboard, XblLeaderboardsContext& context) const
 {
-    // GetLeaderboard puts leaderboard info into Identifier
-    Array<String> parts;
-    leaderboard.Identifier.Split('|', parts);
-    if (parts.Count() != 2)
+    // GetLeaderboard registers leaderboard info under the Identifier (name is checked to reject identifiers from the previous session)
+    int32 handle;
+    if (StringUtils::Parse(leaderboard.Identifier.Get(), &handle) || handle < 0 || handle >= _leaderboards.Count())
         return false;
-    context.Name = StringAnsi(parts[0]);
-    User* localUser = nullptr;
-    if (StringUtils::Parse(parts[1].Get(), parts[1].Length(), (uintptr*)&localUser))
+    XblLeaderboardInfo* info = _leaderboards[handle];
+    if (StringView(info->Title) != leaderboard.Name)
+        return false;
+    User* localUser = info->LocalUser;
+    if (!GetContext(localUser, context.Context))
         return false;
 
     // Init query context
-    const char* scid = nullptr;
-    XblGetScid(&scid);
-    Platform::MemoryCopy(context.Query.scid, scid, sizeof(context.Query.scid));
-    context.Query.leaderboardName = context.Name.Get();
-
-    return GetContext(localUser, context.Context);
+    context.LocalUser = localUser;
+    context.Info = info;
+    context.Query = info->Query;
+    return true;
 }
 
 bool OnlinePlatformXboxLive::GetLeaderboardEntries(XblLeaderboardsContext& context) const
@@ -986,26 +2970,743 @@ bool OnlinePlatformXboxLive::GetLeaderboardEntries(XblLeaderboardsContext& conte
     ab.queue = _taskQueue;
     ab.callback = OnGetLeaderboard;
     ab.context = &context;
-    HRESULT result = XblLeaderboardGetLeaderboardAsync(context.Context, context.Query, &ab);
-    XBOX_LIVE_CHECK_RETURN("XblLeaderboardGetLeaderboardAsync");
-    return XblSyncWait(context, _taskQueue);
+    XblBeginLeaderboardQuery(context);
+    if (XblSyncCall(*this, XblService::Leaderboards, context.LocalUser, context, ab, _taskQueue, TEXT("XblLeaderboardGetLeaderboardAsync"), [&](XAsyncBlock* async)
+    {
+        return Backend->LeaderboardGetLeaderboardAsync(context.Context, context.Query, async);
+    }))
+        return true;
+    XblApplyLeaderboardQuery(context);
+    return false;
+}
+
+void OnlinePlatformXboxLive::ClosePresenceSubscription(User* localUser)
+{
+    XblPresenceSubscription* subscription;
+    if (!_presenceSubscriptions.TryGet(localUser, subscription))
+        return;
+    XblPresenceRemoveDevicePresenceChangedHandler(subscription->Context, subscription->DeviceHandler);
+    XblPresenceRemoveTitlePresenceChangedHandler(subscription->Context, subscription->TitleHandler);
+    XblPresenceStopTrackingUsers(subscription->Context, subscription->Users.Get(), subscription->Users.Count());
+    for (const uint64 xboxUserId : subscription->Users)
+        ReleasePresence(xboxUserId);
+    Backend->ContextCloseHandle(subscription->Context);
+    Delete(subscription);
+    _presenceSubscriptions.Remove(localUser);
+}
+
+XblPresenceSubscription* OnlinePlatformXboxLive::TrackPresence(const Array<Guid, HeapAllocation>& users, User* localUser, XblContextHandle context, int32& start)
+{
+    XblPresenceSubscription* subscription;
+    start = 0;
+    if (!_presenceSubscriptions.TryGet(localUser, subscription))
+    {
+        // Register for real-time activity presence updates
+        subscription = New<XblPresenceSubscription>();
+        Backend->ContextDuplicateHandle(context, &subscription->Context);
+        subscription->DeviceHandler = XblPresenceAddDevicePresenceChangedHandler(context, OnDevicePresenceChanged, _completions);
+        subscription->TitleHandler = XblPresenceAddTitlePresenceChangedHandler(context, OnTitlePresenceChanged, _completions);
+        _presenceSubscriptions.Add(localUser, subscription);
+
+        // Always track the local user
+        uint64_t xboxUserId;
+        Backend->ContextGetXboxUserId(context, &xboxUserId);
+        subscription->Users.Add(xboxUserId);
+    }
+    else
+    {
+        start = subscription->Users.Count();
+    }
+
+    // Add new users to track
+    for (const Guid& userId : users)
+    {
+        const uint64 xboxUserId = GetXboxUserId(userId);
+        if (!subscription->Users.Contains(xboxUserId))
+            subscription->Users.Add(xboxUserId);
+    }
+    const int32 trackCount = subscription->Users.Count() - start;
+    if (trackCount == 0)
+        return subscription;
+    HRESULT result = XblPresenceTrackUsers(context, subscription->Users.Get() + start, trackCount);
+    XBOX_LIVE_LOG("XblPresenceTrackUsers");
+    if (FAILED(result))
+    {
+        // Keep the tracked users list in sync with the service
+        subscription->Users.Resize(start);
+        if (start == 0)
+            ClosePresenceSubscription(localUser);
+        return nullptr;
+    }
+
+    // Presence of the user can be tracked by the subscriptions of many local users
+    for (int32 i = start; i < subscription->Users.Count(); i++)
+        _presenceRefs[subscription->Users[i]]++;
+    return subscription;
+}
+
+void OnlinePlatformXboxLive::QueryPresence(User* localUser, XblContextHandle context, const uint64* users, int32 count)
+{
+    if (count == 0 || XblIsServiceDown(XblService::Presence, CircuitBreakerCooldown))
+        return;
+    auto queryContext = New<XblPresenceQueryContext>();
+    queryContext->Operation.LocalUser = localUser;
+    Backend->ContextDuplicateHandle(context, &queryContext->Context);
+    queryContext->Users.Set(users, count);
+    queryContext->Completions = _completions;
+    queryContext->Async.queue = _taskQueue;
+    queryContext->Async.callback = OnQueryPresenceForUsers;
+    queryContext->Async.context = queryContext;
+    HRESULT result = XblPresenceGetPresenceForMultipleUsersAsync(queryContext->Context, queryContext->Users.Get(), queryContext->Users.Count(), nullptr, &queryContext->Async);
+    XBOX_LIVE_LOG("XblPresenceGetPresenceForMultipleUsersAsync");
+    if (FAILED(result))
+    {
+        XblReportService(XblService::Presence, result, CircuitBreakerThreshold);
+        Backend->ContextCloseHandle(queryContext->Context);
+        Delete(queryContext);
+        return;
+    }
+    XblTrackOperation(queryContext->Operation, &queryContext->Async);
+    _backgroundTasks++;
+}
+
+void OnlinePlatformXboxLive::ReleasePresence(uint64 xboxUserId)
+{
+    // Forget the presence only when no other local user tracks it
+    int32* refs = _presenceRefs.TryGet(xboxUserId);
+    if (refs && --*refs > 0)
+        return;
+    _presenceRefs.Remove(xboxUserId);
+    _presence.Remove(xboxUserId);
+}
+
+void OnlinePlatformXboxLive::ReleaseSignOutDeferral(User* localUser)
+{
+    XUserSignOutDeferralHandle deferral;
+    if (_signOutDeferrals.TryGet(localUser, deferral))
+    {
+        XUserCloseSignOutDeferralHandle(deferral);
+        _signOutDeferrals.Remove(localUser);
+    }
+}
+
+void OnlinePlatformXboxLive::DrainOperations(User* localUser)
+{
+    PROFILE_CPU();
+
+    // Give the requests in flight some time to end and cancel the remaining ones after it
+    const double cancelTime = Platform::GetTimeSeconds() + Math::Max(DrainTimeout, 0.0f);
+    const double endTime = cancelTime + XBOX_LIVE_CANCEL_TIMEOUT;
+    bool canceled = false;
+    int32 pending;
+    while (true)
+    {
+        pending = XblCountOperations(localUser);
+        const double time = Platform::GetTimeSeconds();
+        if (pending == 0 || time >= endTime)
+            break;
+        if (!canceled && time >= cancelTime)
+        {
+            canceled = true;
+            CancelOperations(localUser);
+        }
+        if (!Worker)
+            XblDispatch(_taskQueue);
+        ProcessCompletions();
+        Platform::Sleep(1);
+    }
+    if (pending != 0)
+        LOG(Warning, "{0} Xbox Live requests didn't end after cancel", pending);
+}
+
+void OnlinePlatformXboxLive::RegisterLocalUser(User* localUser)
+{
+    XUserLocalId localId;
+    if (SUCCEEDED(Backend->UserGetLocalId(localUser->UserHandle, &localId)))
+        _localUsers[localId.value] = localUser;
+}
+
+void OnlinePlatformXboxLive::UnregisterLocalUser(User* localUser)
+{
+    for (auto i = _localUsers.Begin(); i.IsNotEnd(); ++i)
+    {
+        if (i->Value == localUser)
+        {
+            _localUsers.Remove(i);
+            break;
+        }
+    }
+}
+
+void OnlinePlatformXboxLive::HandleUserChange(uint64 userLocalId, int32 change, XUserSignOutDeferralHandle deferral)
+{
+    User* localUser;
+    if (!_localUsers.TryGet(userLocalId, localUser))
+    {
+        if (deferral)
+            XUserCloseSignOutDeferralHandle(deferral);
+        return;
+    }
+    PROFILE_CPU();
+    const auto event = (XUserChangeEvent)change;
+
+    // User object can be already removed by the engine so use it only as a key unless it's still on the users list
+    const bool valid = Platform::Users.Contains(localUser);
+    if (event == XUserChangeEvent::SigningOut && valid)
+    {
+        // Last chance to send the user data (sign out is deferred until the user requests end, see OnUpdate)
+        XblUserStats* stats;
+        if (_stats.TryGet(localUser, stats))
+            FlushUserStats(localUser, stats);
+        if (deferral)
+        {
+            ReleaseSignOutDeferral(localUser);
+            _signOutDeferrals.Add(localUser, deferral);
+        }
+        return;
+    }
+    if (deferral)
+        XUserCloseSignOutDeferralHandle(deferral);
+    if (event == XUserChangeEvent::SignedOut || !valid)
+    {
+        // Drop everything related to the user (requests in flight get some time to end before they're canceled)
+        DrainOperations(localUser);
+        ReleaseSignOutDeferral(localUser);
+        ClosePresenceSubscription(localUser);
+        XblUserStats* stats;
+        if (_stats.TryGet(localUser, stats))
+        {
+            Delete(stats);
+            _stats.Remove(localUser);
+        }
+        XblUserPresence* presence;
+        if (_richPresence.TryGet(localUser, presence))
+        {
+            Delete(presence);
+            _richPresence.Remove(localUser);
+        }
+        if (const XGameSaveProviderHandle* provider = _gameSaveProviders.TryGet(localUser))
+        {
+            Backend->GameSaveCloseProvider(*provider);
+            _gameSaveProviders.Remove(localUser);
+        }
+        XblContextHandle context;
+        if (_users.TryGet(localUser, context))
+        {
+            uint64_t xboxUserId;
+            if (SUCCEEDED(Backend->ContextGetXboxUserId(context, &xboxUserId)))
+                ProfileCache.Remove(xboxUserId);
+            Backend->ContextCloseHandle(context);
+            _users.Remove(localUser);
+        }
+        _localUsers.Remove(userLocalId);
+        LOG(Info, "Xbox Live user signed out");
+        return;
+    }
+
+    XblContextHandle context;
+    const bool loggedIn = _users.TryGet(localUser, context);
+    switch (event)
+    {
+    case XUserChangeEvent::SignedInAgain:
+    {
+        // Recreate the context (the old one holds the outdated user session)
+        if (loggedIn)
+        {
+            // Presence subscription handlers are registered on the old context so track the same users with the new one
+            Array<Guid> presenceUsers;
+            XblPresenceSubscription* subscription;
+            const bool subscribed = _presenceSubscriptions.TryGet(localUser, subscription);
+            if (subscribed)
+            {
+                for (int32 i = 1; i < subscription->Users.Count(); i++)
+                    presenceUsers.Add(GetUserId(subscription->Users[i]));
+                ClosePresenceSubscription(localUser);
+            }
+
+            Backend->ContextCloseHandle(context);
+            _users.Remove(localUser);
+            HRESULT result = Backend->ContextCreateHandle(localUser->UserHandle, &context);
+            XBOX_LIVE_LOG("XblContextCreateHandle");
+            if (SUCCEEDED(result))
+            {
+                _users.Add(localUser, context);
+
+                // Query presence of the tracked users in the background to not block the main thread
+                int32 start;
+                if (subscribed && (subscription = TrackPresence(presenceUsers, localUser, context, start)) != nullptr)
+                    QueryPresence(localUser, context, subscription->Users.Get() + start, subscription->Users.Count() - start);
+            }
+        }
+
+        // Reopen the save game provider in the background
+        if (const XGameSaveProviderHandle* provider = _gameSaveProviders.TryGet(localUser))
+        {
+            Backend->GameSaveCloseProvider(*provider);
+            _gameSaveProviders.Remove(localUser);
+            auto init = New<XblSaveProviderContext>();
+            init->Operation.LocalUser = localUser;
+            init->Completions = _completions;
+            init->Async.queue = _taskQueue;
+            init->Async.callback = OnInitializeSaveProvider;
+            init->Async.context = init;
+            const char* scid = nullptr;
+            Backend->GetScid(&scid);
+            HRESULT result = Backend->GameSaveInitializeProviderAsync(localUser->UserHandle, scid, true, &init->Async);
+            XBOX_LIVE_LOG("XGameSaveInitializeProviderAsync");
+            if (SUCCEEDED(result))
+            {
+                XblTrackOperation(init->Operation, &init->Async);
+                _backgroundTasks++;
+            }
+            else
+            {
+                Delete(init);
+            }
+        }
+        break;
+    }
+    case XUserChangeEvent::Gamertag:
+    case XUserChangeEvent::GamerPicture:
+        // Profile will be fetched again on the next use
+        if (loggedIn)
+        {
+            uint64_t xboxUserId;
+            if (SUCCEEDED(Backend->ContextGetXboxUserId(context, &xboxUserId)))
+            {
+                ProfileCache.Remove(xboxUserId);
+                if (event == XUserChangeEvent::Gamertag)
+                {
+                    // Update cached leaderboard rows of the user
+                    char gamerTag[XUserGamertagComponentModernMaxBytes];
+                    size_t gamerTagSize;
+                    if (SUCCEEDED(Backend->UserGetGamertag(localUser->UserHandle, XUserGamertagComponent::Modern, ARRAY_COUNT(gamerTag), gamerTag, &gamerTagSize)))
+                    {
+                        const String name(gamerTag);
+                        for (auto& e : _leaderboardCaches)
+                            e.Value->SetGamerTag(xboxUserId, name);
+                    }
+                }
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+XblUserStats* OnlinePlatformXboxLive::GetUserStats(User* localUser)
+{
+    XblUserStats* stats;
+    if (!_stats.TryGet(localUser, stats))
+    {
+        stats = New<XblUserStats>();
+        _stats.Add(localUser, stats);
+    }
+    return stats;
+}
+
+void OnlinePlatformXboxLive::FlushUserStats(User* localUser, XblUserStats* stats)
+{
+    XblContextHandle context;
+    if (stats->Pending.IsEmpty() || !GetContext(localUser, context))
+        return;
+    if (XblIsServiceDown(XblService::Stats, CircuitBreakerCooldown))
+        return; // Keep stats pending until service is back
+    PROFILE_CPU();
+
+    // Send all pending stats of this user in a single update
+    auto update = New<XblStatsUpdateContext>();
+    update->LocalUser = localUser;
+    update->Operation.LocalUser = localUser;
+    Backend->ContextDuplicateHandle(context, &update->Context);
+    update->Stats.Swap(stats->Pending);
+    update->Statistics.Resize(update->Stats.Count());
+    for (int32 i = 0; i < update->Stats.Count(); i++)
+    {
+        XblTitleManagedStatistic& statistic = update->Statistics[i];
+        statistic.statisticName = update->Stats[i].Name.Get();
+        statistic.statisticType = XblTitleManagedStatType::Number;
+        statistic.numberValue = update->Stats[i].Value;
+        statistic.stringValue = nullptr;
+    }
+    update->Completions = _completions;
+    update->Async.queue = _taskQueue;
+    update->Async.callback = OnUpdateStats;
+    update->Async.context = update;
+    HRESULT result = XblTitleManagedStatsUpdateStatsAsync(update->Context, update->Statistics.Get(), update->Statistics.Count(), &update->Async);
+    XBOX_LIVE_LOG("XblTitleManagedStatsUpdateStatsAsync");
+    if (FAILED(result))
+    {
+        XblReportService(XblService::Stats, result, CircuitBreakerThreshold);
+        stats->Restore(update->Stats, XblIsTransientError(result));
+        Backend->ContextCloseHandle(update->Context);
+        Delete(update);
+        return;
+    }
+    XblTrackOperation(update->Operation, &update->Async);
+    _backgroundTasks++;
+}
+
+void OnlinePlatformXboxLive::FlushPresence()
+{
+    const double time = Platform::GetTimeSeconds();
+    for (auto& e : _richPresence)
+    {
+        XblUserPresence* presence = e.Value;
+        if (presence->Sending || time - presence->SendTime < PresenceMinInterval)
+            continue;
+        const bool changed = !presence->HasSent || presence->Current != presence->Sent;
+        const bool heartbeat = PresenceHeartbeatInterval > 0.0f && time - presence->SendTime >= PresenceHeartbeatInterval;
+        if (!changed && !heartbeat)
+            continue;
+        User* localUser = e.Key;
+        XblContextHandle context;
+        if (!GetContext(localUser, context) || XblIsServiceDown(XblService::Presence, CircuitBreakerCooldown))
+            continue;
+        PROFILE_CPU();
+
+        // Send the latest presence in the background
+        auto update = New<XblPresenceUpdateContext>();
+        update->Operation.LocalUser = localUser;
+        Backend->ContextDuplicateHandle(context, &update->Context);
+        update->Presence = presence->Current;
+        XblPresenceRichPresenceIds* ids = nullptr;
+        if (update->Presence.Id.HasChars())
+        {
+            const char* scid = nullptr;
+            Backend->GetScid(&scid);
+            Platform::MemoryCopy(update->Ids.scid, scid, sizeof(update->Ids.scid));
+            update->Tokens.Resize(update->Presence.Tokens.Count());
+            for (int32 i = 0; i < update->Tokens.Count(); i++)
+                update->Tokens[i] = update->Presence.Tokens[i].Get();
+            update->Ids.presenceId = update->Presence.Id.Get();
+            update->Ids.presenceTokenIds = update->Tokens.Get();
+            update->Ids.presenceTokenIdsCount = update->Tokens.Count();
+            ids = &update->Ids;
+        }
+        update->Completions = _completions;
+        update->Async.queue = _taskQueue;
+        update->Async.callback = OnSetPresence;
+        update->Async.context = update;
+        presence->SendTime = time;
+        HRESULT result = XblPresenceSetPresenceAsync(update->Context, update->Presence.Active, ids, &update->Async);
+        XBOX_LIVE_LOG("XblPresenceSetPresenceAsync");
+        if (FAILED(result))
+        {
+            XblReportService(XblService::Presence, result, CircuitBreakerThreshold);
+            Backend->ContextCloseHandle(update->Context);
+            Delete(update);
+            continue;
+        }
+        XblTrackOperation(update->Operation, &update->Async);
+        presence->Sending = true;
+        _backgroundTasks++;
+    }
+}
+
+XblLeaderboardInfo* OnlinePlatformXboxLive::GetLeaderboardInfo(const StringView& name, User* localUser)
+{
+    // Find the registered leaderboard without building the key string (there are only a few leaderboards per local user)
+    for (XblLeaderboardInfo* info : _leaderboards)
+    {
+        if (info->LocalUser == localUser && StringView(info->Title) == name)
+            return info;
+    }
+    auto info = New<XblLeaderboardInfo>();
+    info->Identifier = StringUtils::ToString(_leaderboards.Count());
+    info->Title = name;
+    info->Name = StringAnsi(name);
+    info->LocalUser = localUser;
+    const char* scid = nullptr;
+    Backend->GetScid(&scid);
+    Platform::MemoryCopy(info->Query.scid, scid, sizeof(info->Query.scid));
+    info->Query.leaderboardName = info->Name.Get();
+    _leaderboards.Add(info);
+    return info;
+}
+
+XblLeaderboardCache* OnlinePlatformXboxLive::GetLeaderboardCache(XblLeaderboardInfo* info, int32 end)
+{
+    if (LeaderboardCacheTTL <= 0.0f || end > XBOX_LIVE_LEADERBOARD_CACHE_MAX_ROWS)
+        return nullptr;
+    if (!info->Cache)
+    {
+        // Leaderboard rows are the same for all local users
+        if (!_leaderboardCaches.TryGet(info->Name, info->Cache))
+        {
+            info->Cache = New<XblLeaderboardCache>();
+            _leaderboardCaches.Add(info->Name, info->Cache);
+        }
+    }
+    return info->Cache;
+}
+
+void OnlinePlatformXboxLive::PrefetchLeaderboardEntries(const XblLeaderboardsContext& context, XblLeaderboardCache* cache, int32 start, int32 count)
+{
+    if (!LeaderboardPrefetch || !cache || cache->PrefetchStart != -1 || count <= 0 || start + count > XBOX_LIVE_LEADERBOARD_CACHE_MAX_ROWS)
+        return;
+    if ((cache->TotalCount >= 0 && start >= cache->TotalCount) || cache->HasRows(start, count, Platform::GetTimeSeconds() - LeaderboardCacheTTL))
+        return;
+    if (XblIsServiceDown(XblService::Leaderboards, CircuitBreakerCooldown))
+        return;
+    PROFILE_CPU();
+
+    // Query the next window of rows in the background (results are put into the cache)
+    auto prefetch = New<XblLeaderboardsPrefetchContext>();
+    prefetch->Operation.LocalUser = context.LocalUser;
+    Backend->ContextDuplicateHandle(context.Context, &prefetch->Context);
+    prefetch->Info = context.Info;
+    prefetch->Query = context.Query;
+    prefetch->Query.skipResultToRank = start;
+    prefetch->Query.maxItems = count;
+    prefetch->Entries = &prefetch->Rows;
+    prefetch->Cache = cache;
+    prefetch->CacheStart = start;
+    XblBeginLeaderboardQuery(*prefetch);
+    prefetch->Completions = _completions;
+    prefetch->Async.queue = _taskQueue;
+    prefetch->Async.callback = OnPrefetchLeaderboard;
+    prefetch->Async.context = prefetch;
+    HRESULT result = Backend->LeaderboardGetLeaderboardAsync(prefetch->Context, prefetch->Query, &prefetch->Async);
+    XBOX_LIVE_LOG("XblLeaderboardGetLeaderboardAsync");
+    if (FAILED(result))
+    {
+        XblReportService(XblService::Leaderboards, result, CircuitBreakerThreshold);
+        Backend->ContextCloseHandle(prefetch->Context);
+        Delete(prefetch);
+        return;
+    }
+    XblTrackOperation(prefetch->Operation, &prefetch->Async);
+    cache->PrefetchStart = start;
+    _backgroundTasks++;
 }
 
 bool OnlinePlatformXboxLive::GetContext(User*& localUser, XblContext*& context) const
 {
-    if (Platform::Users.Count() == 0)
-        return false;
     if (!localUser)
+    {
+        if (Platform::Users.Count() == 0)
+            return false;
         localUser = Platform::Users.First();
+    }
     return _users.TryGet(localUser, context);
 }
 
+int32 OnlinePlatformXboxLive::ProcessCompletions(double endTime)
+{
+    int32 count = 0;
+    XblCompletion completion;
+    while ((endTime <= 0.0 || count == 0 || Platform::GetTimeSeconds() < endTime) && _completions->try_dequeue(completion))
+    {
+        count++;
+        switch (completion.Type)
+        {
+        case XblCompletion::Types::LeaderboardPrefetch:
+        {
+            auto context = (XblLeaderboardsPrefetchContext*)completion.Context;
+            const HRESULT result = XAsyncGetStatus(&context->Async, false);
+            XblTraceCall(TEXT("XblLeaderboardGetLeaderboardAsync"), context->Operation.StartTime, result);
+            XblReportService(XblService::Leaderboards, result, CircuitBreakerThreshold);
+            if (!context->IsFailed())
+                XblApplyLeaderboardQuery(*context);
+            context->Cache->PrefetchStart = -1;
+            XblUntrackOperation(context->Operation);
+            Backend->ContextCloseHandle(context->Context);
+            Delete(context);
+            _backgroundTasks--;
+            break;
+        }
+        case XblCompletion::Types::StatsUpdate:
+        {
+            auto context = (XblStatsUpdateContext*)completion.Context;
+            const HRESULT result = XAsyncGetStatus(&context->Async, false);
+            XblTraceCall(TEXT("XblTitleManagedStatsUpdateStatsAsync"), context->Operation.StartTime, result);
+            XblReportService(XblService::Stats, result, CircuitBreakerThreshold);
+            XblUserStats* stats;
+            if (SUCCEEDED(result))
+            {
+                // Cached rows of the updated leaderboards are outdated
+                XblLeaderboardCache* cache;
+                for (const XblPendingStat& e : context->Stats)
+                {
+                    if (_leaderboardCaches.TryGet(e.Name, cache))
+                        cache->Clear();
+                }
+            }
+            else if (_stats.TryGet(context->LocalUser, stats))
+            {
+                stats->Restore(context->Stats, XblIsTransientError(result));
+            }
+            XblUntrackOperation(context->Operation);
+            Backend->ContextCloseHandle(context->Context);
+            Delete(context);
+            _backgroundTasks--;
+            break;
+        }
+        case XblCompletion::Types::AchievementUpdate:
+        {
+            auto context = (XblAchievementUpdateContext*)completion.Context;
+            HRESULT result = XAsyncGetStatus(&context->Async, false);
+            if (result == HTTP_E_STATUS_NOT_MODIFIED)
+                result = S_OK; // Achievement progress was already set
+            XblTraceCall(TEXT("XblAchievementsUpdateAchievementAsync"), context->Operation.StartTime, result);
+            XblReportService(XblService::Achievements, result, CircuitBreakerThreshold);
+            XBOX_LIVE_LOG("XblAchievementsUpdateAchievementAsync");
+            XblUntrackOperation(context->Operation);
+            Delete(context);
+            _backgroundTasks--;
+            break;
+        }
+        case XblCompletion::Types::SaveProviderInit:
+        {
+            auto context = (XblSaveProviderContext*)completion.Context;
+            User* localUser = context->Operation.LocalUser;
+            XGameSaveProviderHandle provider;
+            HRESULT result = Backend->GameSaveInitializeProviderResult(&context->Async, &provider);
+            XblTraceCall(TEXT("XGameSaveInitializeProviderAsync"), context->Operation.StartTime, result);
+            if (result != E_ABORT)
+                XBOX_LIVE_LOG("XGameSaveInitializeProviderResult");
+            if (SUCCEEDED(result))
+            {
+                // Provider could be created meanwhile by the save game request or the user could be gone (signed out or platform deinitialized)
+                if (_gameSaveProviders.ContainsKey(localUser) || !_users.ContainsKey(localUser) || !Platform::Users.Contains(localUser))
+                    Backend->GameSaveCloseProvider(provider);
+                else
+                    _gameSaveProviders.Add(localUser, provider);
+            }
+            XblUntrackOperation(context->Operation);
+            Delete(context);
+            _backgroundTasks--;
+            break;
+        }
+        case XblCompletion::Types::PresenceUpdate:
+        {
+            auto context = (XblPresenceUpdateContext*)completion.Context;
+            const HRESULT result = XAsyncGetStatus(&context->Async, false);
+            XblTraceCall(TEXT("XblPresenceSetPresenceAsync"), context->Operation.StartTime, result);
+            XblReportService(XblService::Presence, result, CircuitBreakerThreshold);
+            if (result != E_ABORT)
+                XBOX_LIVE_LOG("XblPresenceSetPresenceAsync");
+            XblUserPresence* presence;
+            if (_richPresence.TryGet(context->Operation.LocalUser, presence))
+            {
+                // Presence that failed due to a transient error is sent again with the next flush
+                presence->Sending = false;
+                if (SUCCEEDED(result) || (result != E_ABORT && !XblIsTransientError(result)))
+                {
+                    presence->Sent = MoveTemp(context->Presence);
+                    presence->HasSent = true;
+                }
+            }
+            XblUntrackOperation(context->Operation);
+            Backend->ContextCloseHandle(context->Context);
+            Delete(context);
+            _backgroundTasks--;
+            break;
+        }
+        case XblCompletion::Types::PresenceQuery:
+        {
+            auto context = (XblPresenceQueryContext*)completion.Context;
+            const HRESULT result = XAsyncGetStatus(&context->Async, false);
+            XblTraceCall(TEXT("XblPresenceGetPresenceForMultipleUsersAsync"), context->Operation.StartTime, result);
+            XblReportService(XblService::Presence, result, CircuitBreakerThreshold);
+            XblUntrackOperation(context->Operation);
+            Backend->ContextCloseHandle(context->Context);
+            Delete(context);
+            _backgroundTasks--;
+            break;
+        }
+        case XblCompletion::Types::UserChange:
+            HandleUserChange(completion.UserLocalId, (int32)completion.UserChange, (XUserSignOutDeferralHandle)completion.Context);
+            break;
+        case XblCompletion::Types::PresenceChange:
+        {
+            if (!_presenceRefs.ContainsKey(completion.XboxUserId))
+                break; // Not tracked anymore
+            const OnlinePresenceStates* prev = _presence.TryGet(completion.XboxUserId);
+            if (prev && *prev == completion.Presence)
+                break;
+            _presence[completion.XboxUserId] = completion.Presence;
+            if (!_presenceChanges.Contains(completion.XboxUserId))
+                _presenceChanges.Add(completion.XboxUserId);
+            break;
+        }
+        case XblCompletion::Types::PresenceLeft:
+        {
+            // User left the device or the title but can be still online on the other one so query the presence with the subscription that tracks the user
+            if (!_presenceRefs.ContainsKey(completion.XboxUserId))
+                break; // Not tracked anymore
+            for (const auto& e : _presenceSubscriptions)
+            {
+                if (e.Value->Users.Contains(completion.XboxUserId))
+                {
+                    QueryPresence(e.Key, e.Value->Context, &completion.XboxUserId, 1);
+                    break;
+                }
+            }
+            break;
+        }
+        }
+    }
+    return count;
+}
+
 void OnlinePlatformXboxLive::OnUpdate()
 {
-    // Flush task queue events
-    while (XTaskQueueDispatch(_taskQueue, XTaskQueuePort::Completion, 0))
+    PROFILE_CPU();
+    const double startTime = Platform::GetTimeSeconds();
+    const double endTime = DispatchBudget > 0 ? startTime + DispatchBudget * 0.000001 : 0.0;
+    XboxLiveDispatchStats stats;
+
+    // Send pending stats and presence
+    if (_stats.HasItems() && startTime - _statsFlushTime >= StatsFlushInterval)
+        FlushStats();
+    if (_richPresence.HasItems())
+        FlushPresence();
+
+    // Flush task queue events (unless worker thread does it) within the frame budget
+    if (!Worker)
+    {
+        while (XblDispatch(_taskQueue))
+        {
+            stats.Dispatched++;
+            if (endTime > 0.0 && Platform::GetTimeSeconds() >= endTime)
+            {
+                stats.CarriedOver = true;
+                break;
+            }
+        }
+    }
+
+    // Process results of the background tasks
+    stats.Dispatched += ProcessCompletions(endTime);
+
+    // Let the signing out users go once their requests ended
+    for (auto i = _signOutDeferrals.Begin(); i.IsNotEnd(); ++i)
+    {
+        if (XblCountOperations(i->Key) == 0)
+        {
+            XUserCloseSignOutDeferralHandle(i->Value);
+            _signOutDeferrals.Remove(i);
+        }
+    }
+
+    // Send presence change events
+    for (int32 i = 0; i < _presenceChanges.Count(); i++)
     {
+        OnlinePresenceStates state;
+        const uint64 xboxUserId = _presenceChanges[i];
+        if (_presence.TryGet(xboxUserId, state))
+            PresenceChanged(GetUserId(xboxUserId), state);
     }
+    _presenceChanges.Clear();
+
+    stats.Backlog = (int32)_completions->size_approx() + (int32)Math::Max(Platform::AtomicRead(&QueuedCallbacks), (int64)0);
+    stats.CarriedOver |= stats.Backlog != 0;
+    stats.PendingTasks = _backgroundTasks;
+    stats.DispatchTime = (float)((Platform::GetTimeSeconds() - startTime) * 1000.0);
+    _dispatchStats = stats;
 }
 
 #endif
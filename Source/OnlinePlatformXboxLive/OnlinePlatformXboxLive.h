@@ -2,11 +2,173 @@
 
 #pragma once
 
-#if PLATFORM_GDK
-
 #include "Engine/Online/IOnlinePlatform.h"
 #include "Engine/Scripting/ScriptingObject.h"
 #include "Engine/Core/Collections/Dictionary.h"
+#include "Engine/Core/Delegate.h"
+
+/// <summary>
+/// The Xbox Live callbacks dispatch statistics for a single frame.
+/// </summary>
+API_STRUCT(NoDefault, Namespace="FlaxEngine.Online.XboxLive") struct ONLINEPLATFORMXBOXLIVE_API XboxLiveDispatchStats
+{
+    DECLARE_SCRIPTING_TYPE_MINIMAL(XboxLiveDispatchStats);
+
+    /// <summary>
+    /// The time (in milliseconds) spent on dispatching callbacks and processing results during the frame.
+    /// </summary>
+    API_FIELD() float DispatchTime = 0.0f;
+
+    /// <summary>
+    /// The amount of callbacks and results processed during the frame.
+    /// </summary>
+    API_FIELD() int32 Dispatched = 0;
+
+    /// <summary>
+    /// The amount of callbacks and results left for the next frame (due to the dispatch budget).
+    /// </summary>
+    API_FIELD() int32 Backlog = 0;
+
+    /// <summary>
+    /// True if dispatch budget was exceeded and the remaining callbacks were left for the next frame.
+    /// </summary>
+    API_FIELD() bool CarriedOver = false;
+
+    /// <summary>
+    /// The amount of background tasks (eg. leaderboard prefetch or stats update) in progress.
+    /// </summary>
+    API_FIELD() int32 PendingTasks = 0;
+};
+
+/// <summary>
+/// The Xbox Live SDK and plugin memory usage statistics.
+/// </summary>
+API_STRUCT(NoDefault, Namespace="FlaxEngine.Online.XboxLive") struct ONLINEPLATFORMXBOXLIVE_API XboxLiveMemoryStats
+{
+    DECLARE_SCRIPTING_TYPE_MINIMAL(XboxLiveMemoryStats);
+
+    /// <summary>
+    /// The size (in bytes) of the memory currently allocated by the SDK.
+    /// </summary>
+    API_FIELD() int64 LiveBytes = 0;
+
+    /// <summary>
+    /// The peak size (in bytes) of the memory allocated by the SDK.
+    /// </summary>
+    API_FIELD() int64 PeakBytes = 0;
+
+    /// <summary>
+    /// The size (in bytes) of the memory reserved by the SDK allocator pools for small allocations.
+    /// </summary>
+    API_FIELD() int64 ReservedBytes = 0;
+
+    /// <summary>
+    /// The total amount of the memory blocks allocated by the SDK.
+    /// </summary>
+    API_FIELD() int64 Allocations = 0;
+
+    /// <summary>
+    /// The total amount of the reallocations of the buffers reused for unpacking the requests results. Buffers only grow so it stops changing once the largest results were seen.
+    /// </summary>
+    API_FIELD() int64 ScratchAllocations = 0;
+};
+
+/// <summary>
+/// The achievement of the specific title (see OnlinePlatformXboxLive::GetAchievementsForTitles).
+/// </summary>
+API_STRUCT(NoDefault, Namespace="FlaxEngine.Online.XboxLive") struct ONLINEPLATFORMXBOXLIVE_API XboxLiveTitleAchievement
+{
+    DECLARE_SCRIPTING_TYPE_MINIMAL(XboxLiveTitleAchievement);
+
+    /// <summary>
+    /// The title identifier.
+    /// </summary>
+    API_FIELD() uint32 TitleId = 0;
+
+    /// <summary>
+    /// The achievement.
+    /// </summary>
+    API_FIELD() OnlineAchievement Achievement;
+};
+
+/// <summary>
+/// The types of the stat values.
+/// </summary>
+API_ENUM(Namespace="FlaxEngine.Online.XboxLive") enum class XboxLiveStatTypes
+{
+    /// <summary>
+    /// The integer value (Int32, Int64, UInt32 or UInt64 stat).
+    /// </summary>
+    Int64,
+
+    /// <summary>
+    /// The floating-point value (Float or Double stat).
+    /// </summary>
+    Double,
+
+    /// <summary>
+    /// The boolean value.
+    /// </summary>
+    Bool,
+};
+
+/// <summary>
+/// The stat value with the type reported by the service (keeps full precision of 64-bit counters).
+/// </summary>
+API_STRUCT(NoDefault, Namespace="FlaxEngine.Online.XboxLive") struct ONLINEPLATFORMXBOXLIVE_API XboxLiveStatValue
+{
+    DECLARE_SCRIPTING_TYPE_MINIMAL(XboxLiveStatValue);
+
+    /// <summary>
+    /// The value type.
+    /// </summary>
+    API_FIELD() XboxLiveStatTypes Type = XboxLiveStatTypes::Int64;
+
+    /// <summary>
+    /// The integer value (for Int64 type). UInt64 stats above the range are clamped.
+    /// </summary>
+    API_FIELD() int64 IntValue = 0;
+
+    /// <summary>
+    /// The floating-point value (for Double type).
+    /// </summary>
+    API_FIELD() double DoubleValue = 0.0;
+
+    /// <summary>
+    /// The boolean value (for Bool type).
+    /// </summary>
+    API_FIELD() bool BoolValue = false;
+};
+
+/// <summary>
+/// The stat value of the specific service configuration (see OnlinePlatformXboxLive::GetStatsForServices).
+/// </summary>
+API_STRUCT(NoDefault, Namespace="FlaxEngine.Online.XboxLive") struct ONLINEPLATFORMXBOXLIVE_API XboxLiveServiceStat
+{
+    DECLARE_SCRIPTING_TYPE_MINIMAL(XboxLiveServiceStat);
+
+    /// <summary>
+    /// The service configuration identifier (SCID).
+    /// </summary>
+    API_FIELD() String Scid;
+
+    /// <summary>
+    /// The stat name.
+    /// </summary>
+    API_FIELD() String Name;
+
+    /// <summary>
+    /// The stat value.
+    /// </summary>
+    API_FIELD() float Value = 0.0f;
+
+    /// <summary>
+    /// The stat value with the type reported by the service.
+    /// </summary>
+    API_FIELD() XboxLiveStatValue TypedValue;
+};
+
+#if PLATFORM_GDK
 
 /// <summary>
 /// The online platform implementation for Xbox Live.
@@ -14,11 +176,242 @@
 API_CLASS(Sealed, Namespace="FlaxEngine.Online.XboxLive") class ONLINEPLATFORMXBOXLIVE_API OnlinePlatformXboxLive : public ScriptingObject, public IOnlinePlatform
 {
     DECLARE_SCRIPTING_TYPE(OnlinePlatformXboxLive);
+    friend class XboxLiveReplayBenchmark;
 private:
     struct XTaskQueueObject* _taskQueue = nullptr;
+    struct XblCompletionQueue* _completions = nullptr;
     uint32 _titleId;
     Dictionary<User*, struct XblContext*> _users;
+    Dictionary<uint64, User*> _localUsers;
     Dictionary<User*, struct XGameSaveProvider*> _gameSaveProviders;
+    Dictionary<User*, struct XblUserStats*> _stats;
+    Array<struct XblLeaderboardInfo*> _leaderboards;
+    Dictionary<StringAnsi, struct XblLeaderboardCache*> _leaderboardCaches;
+    Dictionary<User*, struct XblPresenceSubscription*> _presenceSubscriptions;
+    Dictionary<uint64, OnlinePresenceStates> _presence;
+    Dictionary<uint64, int32> _presenceRefs;
+    Dictionary<User*, struct XblUserPresence*> _richPresence;
+    Dictionary<User*, struct XUserSignOutDeferral*> _signOutDeferrals;
+    Array<uint64> _presenceChanges;
+    int32 _backgroundTasks = 0;
+    double _statsFlushTime = 0.0;
+    uint64 _userChangeToken = 0;
+    uint64 _taskQueueMonitorToken = 0;
+    XboxLiveDispatchStats _dispatchStats;
+
+public:
+    /// <summary>
+    /// If checked, the Xbox Live callbacks are dispatched and their results are processed on a dedicated worker thread, instead of the main thread during the engine update. Main thread only picks up the finished results. Must be set before initialization.
+    /// </summary>
+    API_FIELD() bool UseWorkerThread = false;
+
+    /// <summary>
+    /// The time budget (in microseconds) for dispatching Xbox Live callbacks and processing their results on the main thread during a single frame. The remaining work is carried over to the next frame. Use 0 to disable the limit.
+    /// </summary>
+    API_FIELD() int32 DispatchBudget = 2000;
+
+    /// <summary>
+    /// The time (in seconds) after which the cached leaderboard entries are considered outdated and get queried again from the service.
+    /// </summary>
+    API_FIELD() float LeaderboardCacheTTL = 30.0f;
+
+    /// <summary>
+    /// If checked, reading leaderboard entries by rank prefetches the next window of entries in the background (eg. for scrolling leaderboard UI).
+    /// </summary>
+    API_FIELD() bool LeaderboardPrefetch = true;
+
+    /// <summary>
+    /// The interval (in seconds) between sending the pending stats and leaderboard scores to the service. All updates made within that time are sent in a single batch per user.
+    /// </summary>
+    API_FIELD() float StatsFlushInterval = 1.0f;
+
+    /// <summary>
+    /// The maximum amount of retries of the request that failed due to a transient service error (eg. server error or throttling). Use 0 to disable retries.
+    /// </summary>
+    API_FIELD() int32 RetryCount = 2;
+
+    /// <summary>
+    /// The base delay (in seconds) before retrying the failed request. Doubled with each retry (with a random jitter).
+    /// </summary>
+    API_FIELD() float RetryDelay = 0.5f;
+
+    /// <summary>
+    /// The maximum delay (in seconds) before retrying the failed request.
+    /// </summary>
+    API_FIELD() float RetryMaxDelay = 4.0f;
+
+    /// <summary>
+    /// The amount of consecutive transient failures of the service after which its requests fail immediately (without contacting the service) for the cooldown period. Use 0 to disable it.
+    /// </summary>
+    API_FIELD() int32 CircuitBreakerThreshold = 5;
+
+    /// <summary>
+    /// The time (in seconds) for which the service requests fail immediately once the service was detected as unavailable. After that, a single request is sent to check if the service is back.
+    /// </summary>
+    API_FIELD() float CircuitBreakerCooldown = 30.0f;
+
+    /// <summary>
+    /// The time (in seconds) after which the request that got no response from the service is canceled (including its retries). Use 0 to disable the timeout.
+    /// </summary>
+    API_FIELD() float OperationTimeout = 30.0f;
+
+    /// <summary>
+    /// The time (in seconds) given to the requests in flight to complete on user logout or platform deinitialization. The remaining requests are canceled after that time.
+    /// </summary>
+    API_FIELD() float DrainTimeout = 2.0f;
+
+    /// <summary>
+    /// The minimum interval (in seconds) between sending the rich presence of the user. Changes made within that time are coalesced and only the latest presence is sent.
+    /// </summary>
+    API_FIELD() float PresenceMinInterval = 5.0f;
+
+    /// <summary>
+    /// The interval (in seconds) after which the unchanged rich presence is sent again to keep it from expiring. Use 0 to disable it.
+    /// </summary>
+    API_FIELD() float PresenceHeartbeatInterval = 60.0f;
+
+    /// <summary>
+    /// The functions used for the Xbox Live requests. Null to use the Xbox Live SDK. Can be set to the simulated service (eg. by XboxLiveReplayBenchmark) to run the platform without Xbox Live. Must be set before initialization.
+    /// </summary>
+    const struct XboxLiveService* Service = nullptr;
+
+public:
+    /// <summary>
+    /// Event called when presence state of the subscribed user changes. Called on a main thread during the engine update.
+    /// </summary>
+    API_EVENT() Delegate<const Guid&, OnlinePresenceStates> PresenceChanged;
+
+public:
+    /// <summary>
+    /// Gets the initialized Xbox Live platform (null if none). Only a single platform can be initialized at once.
+    /// </summary>
+    static OnlinePlatformXboxLive* GetInstance();
+
+    /// <summary>
+    /// Gets the Xbox Live callbacks dispatch statistics from the last frame.
+    /// </summary>
+    API_PROPERTY() XboxLiveDispatchStats GetDispatchStats() const
+    {
+        return _dispatchStats;
+    }
+
+    /// <summary>
+    /// Subscribes for the presence updates of the given users (and the local user). Presence of the subscribed users is kept up to date with real-time activity updates.
+    /// </summary>
+    /// <param name="users">The list of users (eg. friends) to track.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool SubscribePresence(const Array<Guid, HeapAllocation>& users, User* localUser = nullptr);
+
+    /// <summary>
+    /// Unsubscribes from the presence updates of the given users.
+    /// </summary>
+    /// <param name="users">The list of users to stop tracking.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool UnsubscribePresence(const Array<Guid, HeapAllocation>& users, User* localUser = nullptr);
+
+    /// <summary>
+    /// Sets the rich presence of the local user. Presence is sent in the background: the same presence is not sent again and rapid changes are coalesced (see PresenceMinInterval).
+    /// </summary>
+    /// <param name="presenceId">The rich presence string identifier (configured for the title). Empty to set only the user activity.</param>
+    /// <param name="tokens">The identifiers of the localized strings used by the rich presence string (eg. map name).</param>
+    /// <param name="active">True if user is active in the title, otherwise false.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool SetPresence(const StringView& presenceId, const Array<String, HeapAllocation>& tokens, bool active = true, User* localUser = nullptr);
+
+    /// <summary>
+    /// Gets the cached presence state of the subscribed user.
+    /// </summary>
+    /// <param name="userId">The user identifier.</param>
+    /// <param name="state">The result presence state.</param>
+    /// <returns>True if failed (user presence is unknown), otherwise false.</returns>
+    API_FUNCTION() bool GetPresence(const Guid& userId, API_PARAM(Out) OnlinePresenceStates& state) const;
+
+    /// <summary>
+    /// Gets the memory budget (in bytes) of the user profiles cache shared by local users, friends and leaderboards. The least recently used profiles are removed when cache goes over the budget.
+    /// </summary>
+    API_PROPERTY() int64 GetProfileCacheBudget() const;
+
+    /// <summary>
+    /// Sets the memory budget (in bytes) of the user profiles cache shared by local users, friends and leaderboards. The least recently used profiles are removed when cache goes over the budget.
+    /// </summary>
+    API_PROPERTY() void SetProfileCacheBudget(int64 value);
+
+    /// <summary>
+    /// Gets the avatar picture URL of the user. Available for users which profile was queried (eg. friends).
+    /// </summary>
+    /// <param name="userId">The user identifier.</param>
+    /// <param name="url">The result avatar picture URL.</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool GetUserAvatarUrl(const Guid& userId, API_PARAM(Out) String& url) const;
+
+    /// <summary>
+    /// Gets the achievements of the multiple titles (eg. related games). Queries for all titles are sent at once.
+    /// </summary>
+    /// <param name="titleIds">The list of title identifiers.</param>
+    /// <param name="achievements">The result achievements (tagged with the title identifier).</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed (for all titles), otherwise false.</returns>
+    API_FUNCTION() bool GetAchievementsForTitles(const Array<uint32, HeapAllocation>& titleIds, API_PARAM(Out) Array<XboxLiveTitleAchievement, HeapAllocation>& achievements, User* localUser = nullptr);
+
+    /// <summary>
+    /// Gets the stat value with the type reported by the service (unlike GetStat that converts value to float).
+    /// </summary>
+    /// <param name="name">The stat name.</param>
+    /// <param name="value">The result value.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool GetStatValue(const StringView& name, API_PARAM(Out) XboxLiveStatValue& value, User* localUser = nullptr);
+
+    /// <summary>
+    /// Gets the stats from the multiple service configurations (eg. related games). Queries for all services are sent at once.
+    /// </summary>
+    /// <param name="scids">The list of service configuration identifiers (SCIDs).</param>
+    /// <param name="names">The list of stat names to read.</param>
+    /// <param name="stats">The result stats (tagged with the service configuration identifier). Stats that are not set are not included.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed (for all services), otherwise false.</returns>
+    API_FUNCTION() bool GetStatsForServices(const Array<String, HeapAllocation>& scids, const Array<String, HeapAllocation>& names, API_PARAM(Out) Array<XboxLiveServiceStat, HeapAllocation>& stats, User* localUser = nullptr);
+
+    /// <summary>
+    /// Gets the Xbox Live SDK and plugin memory usage statistics.
+    /// </summary>
+    API_PROPERTY() XboxLiveMemoryStats GetMemoryStats() const;
+
+    /// <summary>
+    /// Gets the size (in bytes) of the memory currently allocated by the SDK for the given memory type (HCMemoryType).
+    /// </summary>
+    /// <param name="memoryType">The SDK memory type.</param>
+    /// <returns>The allocated memory size (in bytes).</returns>
+    API_FUNCTION() int64 GetMemoryUsage(int32 memoryType) const;
+
+    /// <summary>
+    /// Gets the memory budget (in bytes) of the Xbox Live SDK. SDK allocations over the budget fail (and the related requests fail with out of memory error). Use 0 to disable the limit.
+    /// </summary>
+    API_PROPERTY() int64 GetMemoryBudget() const;
+
+    /// <summary>
+    /// Sets the memory budget (in bytes) of the Xbox Live SDK. SDK allocations over the budget fail (and the related requests fail with out of memory error). Use 0 to disable the limit.
+    /// </summary>
+    API_PROPERTY() void SetMemoryBudget(int64 value);
+
+    /// <summary>
+    /// Sends all pending stats and leaderboard scores to the service.
+    /// </summary>
+    API_FUNCTION() void FlushStats();
+
+    /// <summary>
+    /// Cancels the requests in flight (eg. from other threads). Canceled requests fail.
+    /// </summary>
+    /// <param name="localUser">The local user which requests to cancel (null to cancel requests of all users).</param>
+    API_FUNCTION() void CancelOperations(User* localUser = nullptr);
+
+    /// <summary>
+    /// Clears the cached leaderboard entries. The next query will fetch entries from the service.
+    /// </summary>
+    API_FUNCTION() void ClearLeaderboardCache();
 
 public:
     // [IOnlinePlatform]
@@ -51,7 +444,24 @@ private:
     bool GetSaveGameProvider(User*& localUser, XGameSaveProvider*& provider);
     bool GetLeaderboardContext(const OnlineLeaderboard& leaderboard, struct XblLeaderboardsContext& context) const;
     bool GetLeaderboardEntries(XblLeaderboardsContext& context) const;
+    XblLeaderboardInfo* GetLeaderboardInfo(const StringView& name, User* localUser);
+    XblLeaderboardCache* GetLeaderboardCache(XblLeaderboardInfo* info, int32 end);
+    void PrefetchLeaderboardEntries(const XblLeaderboardsContext& context, XblLeaderboardCache* cache, int32 start, int32 count);
     bool GetContext(User*& localUser, XblContext*& context) const;
+    bool ReadStat(const StringView& name, XboxLiveStatValue& value, bool& exists, User* localUser);
+    XblUserStats* GetUserStats(User* localUser);
+    void FlushUserStats(User* localUser, XblUserStats* stats);
+    void FlushPresence();
+    struct XblPresenceSubscription* TrackPresence(const Array<Guid, HeapAllocation>& users, User* localUser, XblContext* context, int32& start);
+    void QueryPresence(User* localUser, XblContext* context, const uint64* users, int32 count);
+    void ClosePresenceSubscription(User* localUser);
+    void ReleasePresence(uint64 xboxUserId);
+    void ReleaseSignOutDeferral(User* localUser);
+    void DrainOperations(User* localUser);
+    void RegisterLocalUser(User* localUser);
+    void UnregisterLocalUser(User* localUser);
+    void HandleUserChange(uint64 userLocalId, int32 change, struct XUserSignOutDeferral* deferral);
+    int32 ProcessCompletions(double endTime = 0.0);
     void OnUpdate();
 };
 
@@ -0,0 +1,943 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#include "OnlinePlatformXboxLiveTrace.h"
+#include "Engine/Core/Log.h"
+#include "Engine/Core/Math/Math.h"
+#include "Engine/Platform/Platform.h"
+#include "Engine/Platform/File.h"
+#include "Engine/Platform/User.h"
+#include "Engine/Profiler/ProfilerCPU.h"
+#include "Engine/Serialization/MemoryReadStream.h"
+#include "Engine/Serialization/MemoryWriteStream.h"
+#include "Engine/Threading/Threading.h"
+
+// Trace file format: header (magic, version, events count) followed by the events (each with its service calls)
+#define XBOX_LIVE_TRACE_MAGIC 0x52544C58
+#define XBOX_LIVE_TRACE_VERSION 2
+
+namespace
+{
+    // The recording trace (receives the service calls made outside of the traced requests, only a single trace can record at once)
+    OnlinePlatformXboxLiveTrace* Recorder = nullptr;
+
+    // The trace recording the request on this thread and the service calls made by that request so far
+    thread_local OnlinePlatformXboxLiveTrace* TraceRequest = nullptr;
+    thread_local Array<OnlinePlatformXboxLiveTrace::Call> TraceCalls;
+
+    // Reads the amount of elements and checks it against the remaining data (corrupted trace could request a huge allocation)
+    bool ReadCount(ReadStream& stream, int32 elementSize, int32& count)
+    {
+        count = 0;
+        stream.ReadInt32(&count);
+        return count < 0 || (uint64)count * elementSize > (uint64)(stream.GetLength() - stream.GetPosition());
+    }
+
+    // Reads the single event of the trace file, returns true if data is invalid
+    bool ReadEvent(ReadStream& stream, OnlinePlatformXboxLiveTrace::Event& e)
+    {
+        e.Op = (OnlinePlatformXboxLiveTrace::Ops)stream.ReadByte();
+        e.Failed = stream.ReadBool();
+        stream.ReadUint16(&e.Pages);
+        stream.ReadFloat(&e.Time);
+        stream.ReadFloat(&e.Duration);
+        stream.ReadString(&e.Key);
+        int32 payloadSize, callsCount;
+        if (ReadCount(stream, 1, payloadSize))
+            return true;
+        e.Payload.Resize(payloadSize);
+        stream.ReadBytes(e.Payload.Get(), payloadSize);
+        if (ReadCount(stream, 1, callsCount))
+            return true;
+        e.Calls.Resize(callsCount);
+        for (OnlinePlatformXboxLiveTrace::Call& call : e.Calls)
+        {
+            stream.ReadString(&call.Method);
+            stream.ReadInt32(&call.Result);
+            stream.ReadFloat(&call.Time);
+            stream.ReadFloat(&call.Duration);
+            int32 pagesCount;
+            if (ReadCount(stream, sizeof(float), pagesCount))
+                return true;
+            call.Pages.Resize(pagesCount);
+            stream.ReadBytes(call.Pages.Get(), pagesCount * sizeof(float));
+        }
+        return false;
+    }
+
+#if PLATFORM_GDK
+    // Gets the traced Xbox Live platform to record its extension API requests (null if traced platform is not the initialized Xbox Live)
+    OnlinePlatformXboxLive* GetTracedXboxLive(IOnlinePlatform* tracedPlatform)
+    {
+        OnlinePlatformXboxLive* xboxLive = OnlinePlatformXboxLive::GetInstance();
+        return xboxLive && static_cast<IOnlinePlatform*>(xboxLive) == tracedPlatform ? xboxLive : nullptr;
+    }
+#endif
+
+    template<typename T>
+    void WriteArray(WriteStream& stream, const Array<T>& values)
+    {
+        stream.WriteInt32(values.Count());
+        for (const T& value : values)
+            OnlinePlatformXboxLiveTrace::Write(stream, value);
+    }
+
+    template<typename T>
+    bool ReadArray(ReadStream& stream, Array<T>& values)
+    {
+        int32 count;
+        if (ReadCount(stream, 1, count))
+        {
+            LOG(Warning, "Invalid request results in Xbox Live trace");
+            values.Clear();
+            return true;
+        }
+        values.Resize(count);
+        for (T& value : values)
+            OnlinePlatformXboxLiveTrace::Read(stream, value);
+        return false;
+    }
+}
+
+OnlinePlatformXboxLiveTrace::OnlinePlatformXboxLiveTrace(const SpawnParams& params)
+    : ScriptingObject(params)
+{
+}
+
+int32 OnlinePlatformXboxLiveTrace::GetEventsCount() const
+{
+    return _events.Count();
+}
+
+bool OnlinePlatformXboxLiveTrace::Save(const StringView& path)
+{
+    PROFILE_CPU();
+    ScopeLock lock(_locker);
+    MemoryWriteStream stream(Math::Max(_events.Count() * 64, 1024));
+    stream.WriteInt32(XBOX_LIVE_TRACE_MAGIC);
+    stream.WriteInt32(XBOX_LIVE_TRACE_VERSION);
+    stream.WriteInt32(_events.Count());
+    for (const Event& e : _events)
+    {
+        stream.WriteByte((byte)e.Op);
+        stream.WriteBool(e.Failed);
+        stream.WriteUint16(e.Pages);
+        stream.WriteFloat(e.Time);
+        stream.WriteFloat(e.Duration);
+        stream.WriteString(e.Key);
+        stream.WriteInt32(e.Payload.Count());
+        stream.WriteBytes(e.Payload.Get(), e.Payload.Count());
+        stream.WriteInt32(e.Calls.Count());
+        for (const Call& call : e.Calls)
+        {
+            stream.WriteString(call.Method);
+            stream.WriteInt32(call.Result);
+            stream.WriteFloat(call.Time);
+            stream.WriteFloat(call.Duration);
+            stream.WriteInt32(call.Pages.Count());
+            stream.WriteBytes(call.Pages.Get(), call.Pages.Count() * sizeof(float));
+        }
+    }
+    if (File::WriteAllBytes(path, stream.GetHandle(), (int32)stream.GetPosition()))
+    {
+        LOG(Error, "Failed to save Xbox Live trace to {0}", path);
+        return true;
+    }
+    return false;
+}
+
+bool OnlinePlatformXboxLiveTrace::Load(const StringView& path)
+{
+    PROFILE_CPU();
+    Array<byte> data;
+    if (File::ReadAllBytes(path, data))
+    {
+        LOG(Error, "Failed to load Xbox Live trace from {0}", path);
+        return true;
+    }
+    MemoryReadStream stream(data.Get(), data.Count());
+    int32 magic = 0, version = 0, count = 0;
+    stream.ReadInt32(&magic);
+    stream.ReadInt32(&version);
+    if (magic != XBOX_LIVE_TRACE_MAGIC || version != XBOX_LIVE_TRACE_VERSION)
+    {
+        LOG(Error, "Invalid Xbox Live trace file {0}", path);
+        return true;
+    }
+    Clear();
+    if (ReadCount(stream, 1, count))
+    {
+        LOG(Error, "Invalid Xbox Live trace file {0}", path);
+        return true;
+    }
+    for (int32 i = 0; i < count && stream.GetPosition() < stream.GetLength(); i++)
+    {
+        Event e;
+        if (ReadEvent(stream, e))
+        {
+            LOG(Error, "Invalid Xbox Live trace file {0} (event {1})", path, i);
+            Clear();
+            return true;
+        }
+        AddEvent(MoveTemp(e));
+    }
+    return false;
+}
+
+void OnlinePlatformXboxLiveTrace::Clear()
+{
+    ScopeLock lock(_locker);
+    _events.Clear();
+    _lookup.Clear();
+    _cursors.Clear();
+}
+
+void OnlinePlatformXboxLiveTrace::AddEvent(Event&& e)
+{
+    ScopeLock lock(_locker);
+    const String lookupKey = String::Format(TEXT("{}|{}"), (int32)e.Op, e.Key);
+    _lookup[lookupKey].Add(_events.Count());
+    _events.Add(MoveTemp(e));
+}
+
+String OnlinePlatformXboxLiveTrace::GetKey(User* localUser, const StringView& name, int32 a, int32 b)
+{
+    // Local users are identified by their index as pointers are different on each run
+    return String::Format(TEXT("{}|{}|{}|{}"), Platform::Users.Find(localUser), name, a, b);
+}
+
+bool OnlinePlatformXboxLiveTrace::IsRecording()
+{
+    return Recorder != nullptr;
+}
+
+void OnlinePlatformXboxLiveTrace::ReportServiceCall(const StringView& method, double startTime, int32 result, const double* pageTimes, int32 pagesCount)
+{
+    OnlinePlatformXboxLiveTrace* trace = TraceRequest ? TraceRequest : Recorder;
+    if (!trace)
+        return;
+    const double endTime = Platform::GetTimeSeconds();
+    Call call;
+    call.Method = method;
+    call.Result = result;
+    call.Time = (float)(startTime - trace->_startTime);
+    call.Duration = (float)(endTime - startTime);
+    call.Pages.Resize(pagesCount);
+    for (int32 i = 0; i < pagesCount; i++)
+        call.Pages[i] = (float)(pageTimes[i] - startTime);
+    if (TraceRequest)
+    {
+        TraceCalls.Add(MoveTemp(call));
+        return;
+    }
+
+    // Call made outside of the traced requests (eg. background task) is recorded as a separate event
+    Event e;
+    e.Op = Ops::ServiceCall;
+    e.Failed = result < 0;
+    e.Pages = (uint16)Math::Clamp(pagesCount, 1, (int32)MAX_uint16);
+    e.Time = call.Time;
+    e.Duration = call.Duration;
+    e.Key = call.Method;
+    e.Calls.Add(MoveTemp(call));
+    trace->AddEvent(MoveTemp(e));
+}
+
+void OnlinePlatformXboxLiveTrace::Write(WriteStream& stream, const OnlineUser& value)
+{
+    stream.WriteBytes(&value.Id, sizeof(Guid));
+    stream.WriteString(value.Name);
+    stream.WriteByte((byte)value.PresenceState);
+}
+
+void OnlinePlatformXboxLiveTrace::Read(ReadStream& stream, OnlineUser& value)
+{
+    stream.ReadBytes(&value.Id, sizeof(Guid));
+    stream.ReadString(&value.Name);
+    value.PresenceState = (OnlinePresenceStates)stream.ReadByte();
+}
+
+void OnlinePlatformXboxLiveTrace::Write(WriteStream& stream, const OnlineAchievement& value)
+{
+    stream.WriteString(value.Identifier);
+    stream.WriteString(value.Name);
+    stream.WriteString(value.Title);
+    stream.WriteString(value.Description);
+    stream.WriteBool(value.IsHidden);
+    stream.WriteFloat(value.Progress);
+    stream.WriteInt64(value.UnlockTime.Ticks);
+}
+
+void OnlinePlatformXboxLiveTrace::Read(ReadStream& stream, OnlineAchievement& value)
+{
+    stream.ReadString(&value.Identifier);
+    stream.ReadString(&value.Name);
+    stream.ReadString(&value.Title);
+    stream.ReadString(&value.Description);
+    value.IsHidden = stream.ReadBool();
+    stream.ReadFloat(&value.Progress);
+    stream.ReadInt64(&value.UnlockTime.Ticks);
+}
+
+void OnlinePlatformXboxLiveTrace::Write(WriteStream& stream, const OnlineLeaderboard& value)
+{
+    stream.WriteString(value.Identifier);
+    stream.WriteString(value.Name);
+    stream.WriteByte((byte)value.SortMode);
+    stream.WriteByte((byte)value.ValueFormat);
+    stream.WriteInt32(value.EntriesCount);
+}
+
+void OnlinePlatformXboxLiveTrace::Read(ReadStream& stream, OnlineLeaderboard& value)
+{
+    stream.ReadString(&value.Identifier);
+    stream.ReadString(&value.Name);
+    value.SortMode = (OnlineLeaderboardSortModes)stream.ReadByte();
+    value.ValueFormat = (OnlineLeaderboardValueFormats)stream.ReadByte();
+    stream.ReadInt32(&value.EntriesCount);
+}
+
+void OnlinePlatformXboxLiveTrace::Write(WriteStream& stream, const OnlineLeaderboardEntry& value)
+{
+    Write(stream, value.User);
+    stream.WriteInt32(value.Rank);
+    stream.WriteInt32(value.Score);
+}
+
+void OnlinePlatformXboxLiveTrace::Read(ReadStream& stream, OnlineLeaderboardEntry& value)
+{
+    Read(stream, value.User);
+    stream.ReadInt32(&value.Rank);
+    stream.ReadInt32(&value.Score);
+}
+
+void OnlinePlatformXboxLiveTrace::Write(WriteStream& stream, const XboxLiveTitleAchievement& value)
+{
+    stream.WriteUint32(value.TitleId);
+    Write(stream, value.Achievement);
+}
+
+void OnlinePlatformXboxLiveTrace::Read(ReadStream& stream, XboxLiveTitleAchievement& value)
+{
+    stream.ReadUint32(&value.TitleId);
+    Read(stream, value.Achievement);
+}
+
+void OnlinePlatformXboxLiveTrace::Write(WriteStream& stream, const XboxLiveStatValue& value)
+{
+    stream.WriteByte((byte)value.Type);
+    stream.WriteInt64(value.IntValue);
+    stream.WriteDouble(value.DoubleValue);
+    stream.WriteBool(value.BoolValue);
+}
+
+void OnlinePlatformXboxLiveTrace::Read(ReadStream& stream, XboxLiveStatValue& value)
+{
+    value.Type = (XboxLiveStatTypes)stream.ReadByte();
+    stream.ReadInt64(&value.IntValue);
+    stream.ReadDouble(&value.DoubleValue);
+    value.BoolValue = stream.ReadBool();
+}
+
+void OnlinePlatformXboxLiveTrace::Write(WriteStream& stream, const XboxLiveServiceStat& value)
+{
+    stream.WriteString(value.Scid);
+    stream.WriteString(value.Name);
+    stream.WriteFloat(value.Value);
+    Write(stream, value.TypedValue);
+}
+
+void OnlinePlatformXboxLiveTrace::Read(ReadStream& stream, XboxLiveServiceStat& value)
+{
+    stream.ReadString(&value.Scid);
+    stream.ReadString(&value.Name);
+    stream.ReadFloat(&value.Value);
+    Read(stream, value.TypedValue);
+}
+
+bool OnlinePlatformXboxLiveTrace::Initialize()
+{
+    _startTime = Platform::GetTimeSeconds();
+    if (Mode == XboxLiveTraceModes::Record)
+    {
+        if (!TracedPlatform)
+        {
+            LOG(Error, "Missing platform to record Xbox Live trace");
+            return true;
+        }
+        if (Recorder)
+        {
+            LOG(Error, "Only a single Xbox Live trace can record at once");
+            return true;
+        }
+        Clear();
+        Recorder = this;
+        if (TracedPlatform->Initialize())
+        {
+            Recorder = nullptr;
+            return true;
+        }
+        return false;
+    }
+    if (TracePath.HasChars() && Load(TracePath))
+        return true;
+    ScopeLock lock(_locker);
+    _cursors.Clear();
+    return false;
+}
+
+void OnlinePlatformXboxLiveTrace::Deinitialize()
+{
+    if (Mode == XboxLiveTraceModes::Record && TracedPlatform)
+    {
+        TracedPlatform->Deinitialize();
+        if (Recorder == this)
+            Recorder = nullptr;
+        if (TracePath.HasChars())
+            Save(TracePath);
+    }
+}
+
+bool OnlinePlatformXboxLiveTrace::UserLogin(User* localUser)
+{
+    if (Mode == XboxLiveTraceModes::Record)
+        return TracedPlatform->UserLogin(localUser);
+    return false;
+}
+
+bool OnlinePlatformXboxLiveTrace::UserLogout(User* localUser)
+{
+    if (Mode == XboxLiveTraceModes::Record)
+        return TracedPlatform->UserLogout(localUser);
+    return false;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetUserLoggedIn(User* localUser)
+{
+    if (Mode == XboxLiveTraceModes::Record)
+        return TracedPlatform->GetUserLoggedIn(localUser);
+    return true;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetUser(OnlineUser& user, User* localUser)
+{
+    const String key = GetKey(localUser);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetUser, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        Read(stream, user);
+        return false;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetUser(user, localUser);
+    MemoryWriteStream stream(64);
+    Write(stream, user);
+    Record(Ops::GetUser, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetFriends(Array<OnlineUser, HeapAllocation>& friends, User* localUser)
+{
+    const String key = GetKey(localUser);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetFriends, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        return ReadArray(stream, friends);
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetFriends(friends, localUser);
+    MemoryWriteStream stream(Math::Max(friends.Count() * 64, 64));
+    WriteArray(stream, friends);
+    Record(Ops::GetFriends, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetAchievements(Array<OnlineAchievement, HeapAllocation>& achievements, User* localUser)
+{
+    const String key = GetKey(localUser);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetAchievements, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        return ReadArray(stream, achievements);
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetAchievements(achievements, localUser);
+    MemoryWriteStream stream(Math::Max(achievements.Count() * 256, 64));
+    WriteArray(stream, achievements);
+    Record(Ops::GetAchievements, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::UnlockAchievement(const StringView& name, User* localUser)
+{
+    const String key = GetKey(localUser, name);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::UnlockAchievement, key, e) || e.Failed;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->UnlockAchievement(name, localUser);
+    Record(Ops::UnlockAchievement, key, startTime, failed);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::UnlockAchievementProgress(const StringView& name, float progress, User* localUser)
+{
+    const String key = GetKey(localUser, name, (int32)progress);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::UnlockAchievementProgress, key, e) || e.Failed;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->UnlockAchievementProgress(name, progress, localUser);
+    Record(Ops::UnlockAchievementProgress, key, startTime, failed);
+    return failed;
+}
+
+#if !BUILD_RELEASE
+
+bool OnlinePlatformXboxLiveTrace::ResetAchievements(User* localUser)
+{
+    const String key = GetKey(localUser);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::ResetAchievements, key, e) || e.Failed;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->ResetAchievements(localUser);
+    Record(Ops::ResetAchievements, key, startTime, failed);
+    return failed;
+}
+
+#endif
+
+bool OnlinePlatformXboxLiveTrace::GetStat(const StringView& name, float& value, User* localUser)
+{
+    const String key = GetKey(localUser, name);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetStat, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        stream.ReadFloat(&value);
+        return false;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetStat(name, value, localUser);
+    MemoryWriteStream stream(sizeof(float));
+    stream.WriteFloat(value);
+    Record(Ops::GetStat, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::SetStat(const StringView& name, float value, User* localUser)
+{
+    const String key = GetKey(localUser, name);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::SetStat, key, e) || e.Failed;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->SetStat(name, value, localUser);
+    Record(Ops::SetStat, key, startTime, failed);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetLeaderboard(const StringView& name, OnlineLeaderboard& value, User* localUser)
+{
+    const String key = GetKey(localUser, name);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetLeaderboard, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        Read(stream, value);
+        return false;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetLeaderboard(name, value, localUser);
+    MemoryWriteStream stream(256);
+    Write(stream, value);
+    Record(Ops::GetLeaderboard, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetOrCreateLeaderboard(const StringView& name, OnlineLeaderboardSortModes sortMode, OnlineLeaderboardValueFormats valueFormat, OnlineLeaderboard& value, User* localUser)
+{
+    const String key = GetKey(localUser, name, (int32)sortMode, (int32)valueFormat);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetOrCreateLeaderboard, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        Read(stream, value);
+        return false;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetOrCreateLeaderboard(name, sortMode, valueFormat, value, localUser);
+    MemoryWriteStream stream(256);
+    Write(stream, value);
+    Record(Ops::GetOrCreateLeaderboard, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetLeaderboardEntries(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries, int32 start, int32 count)
+{
+    const String key = GetKey(nullptr, leaderboard.Name, start, count);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetLeaderboardEntries, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        return ReadArray(stream, entries);
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetLeaderboardEntries(leaderboard, entries, start, count);
+    MemoryWriteStream stream(Math::Max(entries.Count() * 64, 64));
+    WriteArray(stream, entries);
+    Record(Ops::GetLeaderboardEntries, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetLeaderboardEntriesAroundUser(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries, int32 start, int32 count)
+{
+    const String key = GetKey(nullptr, leaderboard.Name, start, count);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetLeaderboardEntriesAroundUser, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        return ReadArray(stream, entries);
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetLeaderboardEntriesAroundUser(leaderboard, entries, start, count);
+    MemoryWriteStream stream(Math::Max(entries.Count() * 64, 64));
+    WriteArray(stream, entries);
+    Record(Ops::GetLeaderboardEntriesAroundUser, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetLeaderboardEntriesForFriends(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries)
+{
+    const String key = GetKey(nullptr, leaderboard.Name);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetLeaderboardEntriesForFriends, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        return ReadArray(stream, entries);
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetLeaderboardEntriesForFriends(leaderboard, entries);
+    MemoryWriteStream stream(Math::Max(entries.Count() * 64, 64));
+    WriteArray(stream, entries);
+    Record(Ops::GetLeaderboardEntriesForFriends, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetLeaderboardEntriesForUsers(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries, const Array<OnlineUser, HeapAllocation>& users)
+{
+    String key = GetKey(nullptr, leaderboard.Name, users.Count());
+    for (const OnlineUser& user : users)
+        key += user.Id.ToString();
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetLeaderboardEntriesForUsers, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        return ReadArray(stream, entries);
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetLeaderboardEntriesForUsers(leaderboard, entries, users);
+    MemoryWriteStream stream(Math::Max(entries.Count() * 64, 64));
+    WriteArray(stream, entries);
+    Record(Ops::GetLeaderboardEntriesForUsers, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::SetLeaderboardEntry(const OnlineLeaderboard& leaderboard, int32 score, bool keepBest)
+{
+    const String key = GetKey(nullptr, leaderboard.Name, score, keepBest ? 1 : 0);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::SetLeaderboardEntry, key, e) || e.Failed;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->SetLeaderboardEntry(leaderboard, score, keepBest);
+    Record(Ops::SetLeaderboardEntry, key, startTime, failed);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetSaveGame(const StringView& name, Array<byte, HeapAllocation>& data, User* localUser)
+{
+    const String key = GetKey(localUser, name);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetSaveGame, key, e) || e.Failed)
+            return true;
+        data = MoveTemp(e.Payload);
+        return false;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->GetSaveGame(name, data, localUser);
+    MemoryWriteStream stream(Math::Max(data.Count(), 1));
+    stream.WriteBytes(data.Get(), data.Count());
+    Record(Ops::GetSaveGame, key, startTime, failed, &stream);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::SetSaveGame(const StringView& name, const Span<byte>& data, User* localUser)
+{
+    const String key = GetKey(localUser, name, data.Length());
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::SetSaveGame, key, e) || e.Failed;
+    }
+    const double startTime = BeginRecord();
+    const bool failed = TracedPlatform->SetSaveGame(name, data, localUser);
+    Record(Ops::SetSaveGame, key, startTime, failed);
+    return failed;
+}
+
+bool OnlinePlatformXboxLiveTrace::SubscribePresence(const Array<Guid, HeapAllocation>& users, User* localUser)
+{
+    String key = GetKey(localUser, StringView::Empty, users.Count());
+    for (const Guid& user : users)
+        key += user.ToString();
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::SubscribePresence, key, e) || e.Failed;
+    }
+#if PLATFORM_GDK
+    if (OnlinePlatformXboxLive* xboxLive = GetTracedXboxLive(TracedPlatform))
+    {
+        const double startTime = BeginRecord();
+        const bool failed = xboxLive->SubscribePresence(users, localUser);
+        Record(Ops::SubscribePresence, key, startTime, failed);
+        return failed;
+    }
+#endif
+    LOG(Error, "Missing Xbox Live platform to record {0}", TEXT("SubscribePresence"));
+    return true;
+}
+
+bool OnlinePlatformXboxLiveTrace::UnsubscribePresence(const Array<Guid, HeapAllocation>& users, User* localUser)
+{
+    String key = GetKey(localUser, StringView::Empty, users.Count());
+    for (const Guid& user : users)
+        key += user.ToString();
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::UnsubscribePresence, key, e) || e.Failed;
+    }
+#if PLATFORM_GDK
+    if (OnlinePlatformXboxLive* xboxLive = GetTracedXboxLive(TracedPlatform))
+    {
+        const double startTime = BeginRecord();
+        const bool failed = xboxLive->UnsubscribePresence(users, localUser);
+        Record(Ops::UnsubscribePresence, key, startTime, failed);
+        return failed;
+    }
+#endif
+    LOG(Error, "Missing Xbox Live platform to record {0}", TEXT("UnsubscribePresence"));
+    return true;
+}
+
+bool OnlinePlatformXboxLiveTrace::SetPresence(const StringView& presenceId, const Array<String, HeapAllocation>& tokens, bool active, User* localUser)
+{
+    String key = GetKey(localUser, presenceId, tokens.Count(), active ? 1 : 0);
+    for (const String& token : tokens)
+    {
+        key += TEXT("|");
+        key += token;
+    }
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        return Replay(Ops::SetPresence, key, e) || e.Failed;
+    }
+#if PLATFORM_GDK
+    if (OnlinePlatformXboxLive* xboxLive = GetTracedXboxLive(TracedPlatform))
+    {
+        const double startTime = BeginRecord();
+        const bool failed = xboxLive->SetPresence(presenceId, tokens, active, localUser);
+        Record(Ops::SetPresence, key, startTime, failed);
+        return failed;
+    }
+#endif
+    LOG(Error, "Missing Xbox Live platform to record {0}", TEXT("SetPresence"));
+    return true;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetStatValue(const StringView& name, XboxLiveStatValue& value, User* localUser)
+{
+    const String key = GetKey(localUser, name);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetStatValue, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        Read(stream, value);
+        return false;
+    }
+#if PLATFORM_GDK
+    if (OnlinePlatformXboxLive* xboxLive = GetTracedXboxLive(TracedPlatform))
+    {
+        const double startTime = BeginRecord();
+        const bool failed = xboxLive->GetStatValue(name, value, localUser);
+        MemoryWriteStream stream(32);
+        Write(stream, value);
+        Record(Ops::GetStatValue, key, startTime, failed, &stream);
+        return failed;
+    }
+#endif
+    LOG(Error, "Missing Xbox Live platform to record {0}", TEXT("GetStatValue"));
+    return true;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetAchievementsForTitles(const Array<uint32, HeapAllocation>& titleIds, Array<XboxLiveTitleAchievement, HeapAllocation>& achievements, User* localUser)
+{
+    String key = GetKey(localUser, StringView::Empty, titleIds.Count());
+    for (const uint32 titleId : titleIds)
+        key += String::Format(TEXT("|{}"), titleId);
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetAchievementsForTitles, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        return ReadArray(stream, achievements);
+    }
+#if PLATFORM_GDK
+    if (OnlinePlatformXboxLive* xboxLive = GetTracedXboxLive(TracedPlatform))
+    {
+        const double startTime = BeginRecord();
+        const bool failed = xboxLive->GetAchievementsForTitles(titleIds, achievements, localUser);
+        MemoryWriteStream stream(Math::Max(achievements.Count() * 256, 64));
+        WriteArray(stream, achievements);
+        Record(Ops::GetAchievementsForTitles, key, startTime, failed, &stream);
+        return failed;
+    }
+#endif
+    LOG(Error, "Missing Xbox Live platform to record {0}", TEXT("GetAchievementsForTitles"));
+    return true;
+}
+
+bool OnlinePlatformXboxLiveTrace::GetStatsForServices(const Array<String, HeapAllocation>& scids, const Array<String, HeapAllocation>& names, Array<XboxLiveServiceStat, HeapAllocation>& stats, User* localUser)
+{
+    String key = GetKey(localUser, StringView::Empty, scids.Count(), names.Count());
+    for (const String& scid : scids)
+    {
+        key += TEXT("|");
+        key += scid;
+    }
+    for (const String& name : names)
+    {
+        key += TEXT("|");
+        key += name;
+    }
+    if (Mode == XboxLiveTraceModes::Replay)
+    {
+        Event e;
+        if (Replay(Ops::GetStatsForServices, key, e) || e.Failed)
+            return true;
+        MemoryReadStream stream(e.Payload.Get(), e.Payload.Count());
+        return ReadArray(stream, stats);
+    }
+#if PLATFORM_GDK
+    if (OnlinePlatformXboxLive* xboxLive = GetTracedXboxLive(TracedPlatform))
+    {
+        const double startTime = BeginRecord();
+        const bool failed = xboxLive->GetStatsForServices(scids, names, stats, localUser);
+        MemoryWriteStream stream(Math::Max(stats.Count() * 128, 64));
+        WriteArray(stream, stats);
+        Record(Ops::GetStatsForServices, key, startTime, failed, &stream);
+        return failed;
+    }
+#endif
+    LOG(Error, "Missing Xbox Live platform to record {0}", TEXT("GetStatsForServices"));
+    return true;
+}
+
+bool OnlinePlatformXboxLiveTrace::Replay(Ops op, const String& key, Event& result)
+{
+    PROFILE_CPU();
+    bool found = false;
+    {
+        // Use the recorded requests with the same parameters in order (the last one is repeated once all were used)
+        // Event is copied under the lock as events can be added from other threads in the meantime
+        ScopeLock lock(_locker);
+        const String lookupKey = String::Format(TEXT("{}|{}"), (int32)op, key);
+        const Array<int32>* events = _lookup.TryGet(lookupKey);
+        if (events && events->HasItems())
+        {
+            int32& cursor = _cursors[lookupKey];
+            result = _events[events->At(Math::Min(cursor, events->Count() - 1))];
+            cursor++;
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        LOG(Warning, "Missing request {0} ({1}) in Xbox Live trace", (int32)op, key);
+        return true;
+    }
+
+    // Simulate service latency
+    if (LatencyScale > 0.0f && result.Duration > 0.0f)
+        Platform::Sleep((int32)(result.Duration * LatencyScale * 1000.0f));
+    return false;
+}
+
+double OnlinePlatformXboxLiveTrace::BeginRecord()
+{
+    // Service calls reported by the traced platform on this thread belong to this request until it's recorded
+    TraceRequest = this;
+    TraceCalls.Clear();
+    return Platform::GetTimeSeconds();
+}
+
+void OnlinePlatformXboxLiveTrace::Record(Ops op, const String& key, double startTime, bool failed, const MemoryWriteStream* payload)
+{
+    const double endTime = Platform::GetTimeSeconds();
+    Event e;
+    e.Op = op;
+    e.Failed = failed;
+    int32 pages = 0;
+    for (const Call& call : TraceCalls)
+        pages += Math::Max(call.Pages.Count(), 1);
+    e.Pages = (uint16)Math::Min(pages, (int32)MAX_uint16);
+    e.Time = (float)(startTime - _startTime);
+    e.Duration = (float)(endTime - startTime);
+    e.Key = key;
+    if (payload && !failed)
+        e.Payload.Set(payload->GetHandle(), (int32)payload->GetPosition());
+    e.Calls = MoveTemp(TraceCalls);
+    TraceRequest = nullptr;
+    AddEvent(MoveTemp(e));
+}
@@ -0,0 +1,299 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#pragma once
+
+#include "OnlinePlatformXboxLive.h"
+#include "Engine/Online/IOnlinePlatform.h"
+#include "Engine/Scripting/ScriptingObject.h"
+#include "Engine/Core/Collections/Dictionary.h"
+#include "Engine/Platform/CriticalSection.h"
+
+class WriteStream;
+class ReadStream;
+class MemoryWriteStream;
+
+/// <summary>
+/// The online services trace modes.
+/// </summary>
+API_ENUM(Namespace="FlaxEngine.Online.XboxLive") enum class XboxLiveTraceModes
+{
+    /// <summary>
+    /// Forwards all requests to the traced platform and records them with their results and timings.
+    /// </summary>
+    Record,
+
+    /// <summary>
+    /// Answers all requests with the results from the recorded trace (doesn't use the online services).
+    /// </summary>
+    Replay,
+};
+
+/// <summary>
+/// The online platform that records the requests and results of another online platform (eg. Xbox Live) into a compact binary trace file, or replays them from that file with the original (or scaled) latency. Can be used to reproduce, profile and benchmark the online services usage off-console in a deterministic way.
+/// When recording OnlinePlatformXboxLive, each request also captures the Xbox Live service calls it made (every attempt with its result, timing and page boundaries) and the service calls of the background tasks (eg. stats flush) are recorded as separate events. The Xbox Live extension API (presence, typed stats and multi-title queries) is traced with the methods of the same name.
+/// Replay answers requests at the IOnlinePlatform interface level so it doesn't run any of the OnlinePlatformXboxLive code (caching, batching, retries or callbacks dispatch), only the game code that uses online platform.
+/// </summary>
+API_CLASS(Sealed, Namespace="FlaxEngine.Online.XboxLive") class ONLINEPLATFORMXBOXLIVE_API OnlinePlatformXboxLiveTrace : public ScriptingObject, public IOnlinePlatform
+{
+    DECLARE_SCRIPTING_TYPE(OnlinePlatformXboxLiveTrace);
+public:
+    // The type of the traced request
+    enum class Ops : byte
+    {
+        GetUser,
+        GetFriends,
+        GetAchievements,
+        UnlockAchievement,
+        UnlockAchievementProgress,
+        ResetAchievements,
+        GetStat,
+        SetStat,
+        GetLeaderboard,
+        GetOrCreateLeaderboard,
+        GetLeaderboardEntries,
+        GetLeaderboardEntriesAroundUser,
+        GetLeaderboardEntriesForFriends,
+        GetLeaderboardEntriesForUsers,
+        SetLeaderboardEntry,
+        GetSaveGame,
+        SetSaveGame,
+        SubscribePresence,
+        UnsubscribePresence,
+        SetPresence,
+        GetStatValue,
+        GetAchievementsForTitles,
+        GetStatsForServices,
+        // The service call made outside of the traced requests (eg. background task), key is the service method name
+        ServiceCall,
+    };
+
+    // The single Xbox Live service call (request attempt) made by the traced platform
+    struct Call
+    {
+        // The service method name (eg. XblLeaderboardGetLeaderboardAsync)
+        String Method;
+        // The call result (HRESULT)
+        int32 Result;
+        // The call start time (in seconds) since the recording start
+        float Time;
+        // The call duration (in seconds)
+        float Duration;
+        // The completion times (in seconds) of the result pages since the call start (empty if call doesn't report pages)
+        Array<float> Pages;
+    };
+
+    // The single request captured in the trace
+    struct Event
+    {
+        Ops Op;
+        bool Failed;
+        // The amount of pages fetched from the service by the request (of all its service calls)
+        uint16 Pages;
+        // The request start time (in seconds) since the recording start
+        float Time;
+        // The request duration (in seconds)
+        float Duration;
+        // The request parameters
+        String Key;
+        // The request results
+        Array<byte> Payload;
+        // The service calls made by the request (in order)
+        Array<Call> Calls;
+    };
+
+private:
+    CriticalSection _locker;
+    Array<Event> _events;
+    Dictionary<String, Array<int32>> _lookup;
+    Dictionary<String, int32> _cursors;
+    double _startTime = 0.0;
+
+public:
+    /// <summary>
+    /// The trace mode. Must be set before initialization.
+    /// </summary>
+    API_FIELD() XboxLiveTraceModes Mode = XboxLiveTraceModes::Replay;
+
+    /// <summary>
+    /// The online platform to record (eg. OnlinePlatformXboxLive). Initialized and deinitialized by the trace.
+    /// </summary>
+    API_FIELD() IOnlinePlatform* TracedPlatform = nullptr;
+
+    /// <summary>
+    /// The trace file path. Loaded on initialization when replaying, saved on deinitialization when recording. Optional.
+    /// </summary>
+    API_FIELD() String TracePath;
+
+    /// <summary>
+    /// The scale of the replayed requests latency. Use 1 for the original latency, 0 to answer requests immediately.
+    /// </summary>
+    API_FIELD() float LatencyScale = 1.0f;
+
+public:
+    /// <summary>
+    /// Gets the amount of requests in the trace.
+    /// </summary>
+    API_PROPERTY() int32 GetEventsCount() const;
+
+    /// <summary>
+    /// Gets the recorded requests.
+    /// </summary>
+    const Array<Event>& GetEvents() const
+    {
+        return _events;
+    }
+
+    /// <summary>
+    /// Saves the trace to the file.
+    /// </summary>
+    /// <param name="path">The output file path.</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool Save(const StringView& path);
+
+    /// <summary>
+    /// Loads the trace from the file.
+    /// </summary>
+    /// <param name="path">The input file path.</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool Load(const StringView& path);
+
+    /// <summary>
+    /// Clears the trace.
+    /// </summary>
+    API_FUNCTION() void Clear();
+
+    /// <summary>
+    /// Adds the request to the trace (eg. to build a synthetic trace).
+    /// </summary>
+    /// <param name="e">The request.</param>
+    void AddEvent(Event&& e);
+
+    /// <summary>
+    /// Builds the request parameters key used to match requests during replay.
+    /// </summary>
+    /// <param name="localUser">The local user (null if default one).</param>
+    /// <param name="name">The requested item name (eg. stat or leaderboard name).</param>
+    /// <param name="a">The first request parameter (eg. leaderboard entries start).</param>
+    /// <param name="b">The second request parameter (eg. leaderboard entries count).</param>
+    /// <returns>The request key.</returns>
+    static String GetKey(User* localUser, const StringView& name = StringView::Empty, int32 a = 0, int32 b = 0);
+
+    /// <summary>
+    /// Checks if any trace is recording. The traced platform reports its service calls only then.
+    /// </summary>
+    static bool IsRecording();
+
+    /// <summary>
+    /// Reports the service call (single request attempt) made by the traced platform. Calls made within the request recorded on the calling thread are stored in its event, other calls (eg. background tasks) are recorded as separate events.
+    /// </summary>
+    /// <param name="method">The service method name.</param>
+    /// <param name="startTime">The call start time (see Platform::GetTimeSeconds).</param>
+    /// <param name="result">The call result (HRESULT).</param>
+    /// <param name="pageTimes">The completion times of the result pages (see Platform::GetTimeSeconds). Optional.</param>
+    /// <param name="pagesCount">The amount of the result pages.</param>
+    static void ReportServiceCall(const StringView& method, double startTime, int32 result, const double* pageTimes = nullptr, int32 pagesCount = 0);
+
+public:
+    // Payload serialization
+    static void Write(WriteStream& stream, const OnlineUser& value);
+    static void Read(ReadStream& stream, OnlineUser& value);
+    static void Write(WriteStream& stream, const OnlineAchievement& value);
+    static void Read(ReadStream& stream, OnlineAchievement& value);
+    static void Write(WriteStream& stream, const OnlineLeaderboard& value);
+    static void Read(ReadStream& stream, OnlineLeaderboard& value);
+    static void Write(WriteStream& stream, const OnlineLeaderboardEntry& value);
+    static void Read(ReadStream& stream, OnlineLeaderboardEntry& value);
+    static void Write(WriteStream& stream, const XboxLiveTitleAchievement& value);
+    static void Read(ReadStream& stream, XboxLiveTitleAchievement& value);
+    static void Write(WriteStream& stream, const XboxLiveStatValue& value);
+    static void Read(ReadStream& stream, XboxLiveStatValue& value);
+    static void Write(WriteStream& stream, const XboxLiveServiceStat& value);
+    static void Read(ReadStream& stream, XboxLiveServiceStat& value);
+
+public:
+    /// <summary>
+    /// Subscribes for the presence updates of the given users (see OnlinePlatformXboxLive::SubscribePresence).
+    /// </summary>
+    /// <param name="users">The list of users (eg. friends) to track.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool SubscribePresence(const Array<Guid, HeapAllocation>& users, User* localUser = nullptr);
+
+    /// <summary>
+    /// Unsubscribes from the presence updates of the given users (see OnlinePlatformXboxLive::UnsubscribePresence).
+    /// </summary>
+    /// <param name="users">The list of users to stop tracking.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool UnsubscribePresence(const Array<Guid, HeapAllocation>& users, User* localUser = nullptr);
+
+    /// <summary>
+    /// Sets the rich presence of the local user (see OnlinePlatformXboxLive::SetPresence).
+    /// </summary>
+    /// <param name="presenceId">The rich presence string identifier. Empty to set only the user activity.</param>
+    /// <param name="tokens">The identifiers of the localized strings used by the rich presence string.</param>
+    /// <param name="active">True if user is active in the title, otherwise false.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool SetPresence(const StringView& presenceId, const Array<String, HeapAllocation>& tokens, bool active = true, User* localUser = nullptr);
+
+    /// <summary>
+    /// Gets the stat value with the type reported by the service (see OnlinePlatformXboxLive::GetStatValue).
+    /// </summary>
+    /// <param name="name">The stat name.</param>
+    /// <param name="value">The result value.</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed, otherwise false.</returns>
+    API_FUNCTION() bool GetStatValue(const StringView& name, API_PARAM(Out) XboxLiveStatValue& value, User* localUser = nullptr);
+
+    /// <summary>
+    /// Gets the achievements of the multiple titles (see OnlinePlatformXboxLive::GetAchievementsForTitles).
+    /// </summary>
+    /// <param name="titleIds">The list of title identifiers.</param>
+    /// <param name="achievements">The result achievements (tagged with the title identifier).</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed (for all titles), otherwise false.</returns>
+    API_FUNCTION() bool GetAchievementsForTitles(const Array<uint32, HeapAllocation>& titleIds, API_PARAM(Out) Array<XboxLiveTitleAchievement, HeapAllocation>& achievements, User* localUser = nullptr);
+
+    /// <summary>
+    /// Gets the stats from the multiple service configurations (see OnlinePlatformXboxLive::GetStatsForServices).
+    /// </summary>
+    /// <param name="scids">The list of service configuration identifiers (SCIDs).</param>
+    /// <param name="names">The list of stat names to read.</param>
+    /// <param name="stats">The result stats (tagged with the service configuration identifier).</param>
+    /// <param name="localUser">The local user (null if use default one).</param>
+    /// <returns>True if failed (for all services), otherwise false.</returns>
+    API_FUNCTION() bool GetStatsForServices(const Array<String, HeapAllocation>& scids, const Array<String, HeapAllocation>& names, API_PARAM(Out) Array<XboxLiveServiceStat, HeapAllocation>& stats, User* localUser = nullptr);
+
+public:
+    // [IOnlinePlatform]
+    bool Initialize() override;
+    void Deinitialize() override;
+    bool UserLogin(User* localUser) override;
+    bool UserLogout(User* localUser) override;
+    bool GetUserLoggedIn(User* localUser) override;
+    bool GetUser(OnlineUser& user, User* localUser) override;
+    bool GetFriends(Array<OnlineUser, HeapAllocation>& friends, User* localUser) override;
+    bool GetAchievements(Array<OnlineAchievement, HeapAllocation>& achievements, User* localUser) override;
+    bool UnlockAchievement(const StringView& name, User* localUser) override;
+    bool UnlockAchievementProgress(const StringView& name, float progress, User* localUser) override;
+#if !BUILD_RELEASE
+    bool ResetAchievements(User* localUser) override;
+#endif
+    bool GetStat(const StringView& name, float& value, User* localUser) override;
+    bool SetStat(const StringView& name, float value, User* localUser) override;
+    bool GetLeaderboard(const StringView& name, OnlineLeaderboard& value, User* localUser) override;
+    bool GetOrCreateLeaderboard(const StringView& name, OnlineLeaderboardSortModes sortMode, OnlineLeaderboardValueFormats valueFormat, OnlineLeaderboard& value, User* localUser) override;
+    bool GetLeaderboardEntries(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries, int32 start, int32 count) override;
+    bool GetLeaderboardEntriesAroundUser(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries, int32 start, int32 count) override;
+    bool GetLeaderboardEntriesForFriends(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries) override;
+    bool GetLeaderboardEntriesForUsers(const OnlineLeaderboard& leaderboard, Array<OnlineLeaderboardEntry, HeapAllocation>& entries, const Array<OnlineUser, HeapAllocation>& users) override;
+    bool SetLeaderboardEntry(const OnlineLeaderboard& leaderboard, int32 score, bool keepBest) override;
+    bool GetSaveGame(const StringView& name, Array<byte, HeapAllocation>& data, User* localUser) override;
+    bool SetSaveGame(const StringView& name, const Span<byte>& data, User* localUser) override;
+
+private:
+    bool Replay(Ops op, const String& key, Event& result);
+    double BeginRecord();
+    void Record(Ops op, const String& key, double startTime, bool failed, const MemoryWriteStream* payload = nullptr);
+};
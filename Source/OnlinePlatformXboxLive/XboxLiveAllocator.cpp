@@ -0,0 +1,347 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#if PLATFORM_GDK
+
+#include "XboxLiveAllocator.h"
+#include "Engine/Core/Log.h"
+#include "Engine/Core/Memory/Allocation.h"
+#include "Engine/Platform/Platform.h"
+#include "Engine/Platform/CriticalSection.h"
+#include "Engine/Threading/Threading.h"
+
+// Size classes are powers of two (including block header): 32, 64, ..., 2048 bytes
+#define XBOX_LIVE_ALLOCATOR_MIN_CLASS_SHIFT 5
+#define XBOX_LIVE_ALLOCATOR_CLASSES 7
+#define XBOX_LIVE_ALLOCATOR_CHUNK_SIZE (64 * 1024)
+#define XBOX_LIVE_ALLOCATOR_THREAD_CACHE_SIZE 64
+#define XBOX_LIVE_ALLOCATOR_LARGE_CLASS 0xffffffff
+
+namespace
+{
+    // Header placed before each block (keeps 16-bytes alignment of the user memory)
+    struct alignas(16) BlockHeader
+    {
+        uint32 SizeClass;
+        uint32 MemoryType;
+        uint64 Size;
+    };
+
+    struct FreeBlock
+    {
+        FreeBlock* Next;
+    };
+
+    struct Chunk
+    {
+        Chunk* Next;
+    };
+
+    struct Pool
+    {
+        CriticalSection Locker;
+        FreeBlock* FreeList = nullptr;
+        Chunk* Chunks = nullptr;
+    };
+
+    struct ThreadCache
+    {
+        int64 Generation = -1;
+        FreeBlock* FreeList[XBOX_LIVE_ALLOCATOR_CLASSES] = {};
+        int32 Count[XBOX_LIVE_ALLOCATOR_CLASSES] = {};
+
+        ~ThreadCache();
+    };
+
+    Pool Pools[XBOX_LIVE_ALLOCATOR_CLASSES];
+    thread_local ThreadCache Cache;
+    volatile int64 Generation = 0;
+    volatile int64 LiveBytes = 0;
+    volatile int64 PeakBytes = 0;
+    volatile int64 ReservedBytes = 0;
+    volatile int64 Allocations = 0;
+    volatile int64 Budget = 0;
+    volatile int64 TypeLiveBytes[XboxLiveAllocator::MemoryTypesCount] = {};
+    bool BudgetWarning = false;
+
+    ThreadCache::~ThreadCache()
+    {
+        // Return cached blocks to the pools when thread exits (unless pools were released since then)
+        for (int32 sizeClass = 0; sizeClass < XBOX_LIVE_ALLOCATOR_CLASSES; sizeClass++)
+        {
+            if (!FreeList[sizeClass])
+                continue;
+            Pool& pool = Pools[sizeClass];
+            ScopeLock lock(pool.Locker);
+            if (Generation != Platform::AtomicRead(&::Generation))
+                break;
+            while (FreeList[sizeClass])
+            {
+                FreeBlock* block = FreeList[sizeClass];
+                FreeList[sizeClass] = block->Next;
+                block->Next = pool.FreeList;
+                pool.FreeList = block;
+            }
+            Count[sizeClass] = 0;
+        }
+    }
+
+    uint32 GetSizeClass(uint64 blockSize)
+    {
+        uint32 sizeClass = 0;
+        while (((uint64)1 << (sizeClass + XBOX_LIVE_ALLOCATOR_MIN_CLASS_SHIFT)) < blockSize)
+            sizeClass++;
+        return sizeClass;
+    }
+
+    FORCE_INLINE uint64 GetClassBlockSize(uint32 sizeClass)
+    {
+        return (uint64)1 << (sizeClass + XBOX_LIVE_ALLOCATOR_MIN_CLASS_SHIFT);
+    }
+
+    ThreadCache& GetCache()
+    {
+        // Drop cached blocks from before the pools release
+        ThreadCache& cache = Cache;
+        const int64 generation = Platform::AtomicRead(&Generation);
+        if (cache.Generation != generation)
+        {
+            cache = ThreadCache();
+            cache.Generation = generation;
+        }
+        return cache;
+    }
+
+    // Moves a batch of blocks from the shared pool to the thread cache
+    bool Refill(ThreadCache& cache, uint32 sizeClass)
+    {
+        Pool& pool = Pools[sizeClass];
+        const uint64 blockSize = GetClassBlockSize(sizeClass);
+        ScopeLock lock(pool.Locker);
+        if (cache.Generation != Platform::AtomicRead(&Generation))
+        {
+            // Pools were released in the meantime
+            cache = ThreadCache();
+            cache.Generation = Platform::AtomicRead(&Generation);
+        }
+        if (!pool.FreeList)
+        {
+            // Allocate a new chunk and split it into blocks
+            auto chunk = (Chunk*)Allocator::Allocate(XBOX_LIVE_ALLOCATOR_CHUNK_SIZE, 16);
+            if (!chunk)
+                return false;
+            chunk->Next = pool.Chunks;
+            pool.Chunks = chunk;
+            Platform::InterlockedAdd(&ReservedBytes, XBOX_LIVE_ALLOCATOR_CHUNK_SIZE);
+            byte* start = (byte*)chunk + 16;
+            byte* end = (byte*)chunk + XBOX_LIVE_ALLOCATOR_CHUNK_SIZE;
+            for (byte* ptr = start; ptr + blockSize <= end; ptr += blockSize)
+            {
+                auto block = (FreeBlock*)ptr;
+                block->Next = pool.FreeList;
+                pool.FreeList = block;
+            }
+        }
+        for (int32 i = 0; i < XBOX_LIVE_ALLOCATOR_THREAD_CACHE_SIZE / 2 && pool.FreeList; i++)
+        {
+            FreeBlock* block = pool.FreeList;
+            pool.FreeList = block->Next;
+            block->Next = cache.FreeList[sizeClass];
+            cache.FreeList[sizeClass] = block;
+            cache.Count[sizeClass]++;
+        }
+        return true;
+    }
+
+    // Moves half of the thread cache blocks back to the shared pool
+    void Flush(ThreadCache& cache, uint32 sizeClass)
+    {
+        Pool& pool = Pools[sizeClass];
+        ScopeLock lock(pool.Locker);
+        if (cache.Generation != Platform::AtomicRead(&Generation))
+        {
+            // Pools were released in the meantime so drop the cached blocks
+            cache = ThreadCache();
+            cache.Generation = Platform::AtomicRead(&Generation);
+            return;
+        }
+        for (int32 i = 0; i < XBOX_LIVE_ALLOCATOR_THREAD_CACHE_SIZE / 2; i++)
+        {
+            FreeBlock* block = cache.FreeList[sizeClass];
+            cache.FreeList[sizeClass] = block->Next;
+            cache.Count[sizeClass]--;
+            block->Next = pool.FreeList;
+            pool.FreeList = block;
+        }
+    }
+
+    void UpdatePeak(int64 live)
+    {
+        int64 peak = Platform::AtomicRead(&PeakBytes);
+        while (live > peak)
+        {
+            const int64 prev = Platform::InterlockedCompareExchange(&PeakBytes, live, peak);
+            if (prev == peak)
+                break;
+            peak = prev;
+        }
+    }
+}
+
+void* XboxLiveAllocator::Allocate(uint64 size, uint32 memoryType)
+{
+    // Reserve the memory within the budget (live bytes are counted before using the pools so Release won't free them in the meantime)
+    const int64 budget = Platform::AtomicRead(&Budget);
+    const int64 live = Platform::InterlockedAdd(&LiveBytes, (int64)size) + (int64)size;
+    if (budget > 0 && live > budget)
+    {
+        Platform::InterlockedAdd(&LiveBytes, -(int64)size);
+        if (!BudgetWarning)
+        {
+            BudgetWarning = true;
+            LOG(Warning, "Xbox Live memory budget of {0} bytes exceeded", budget);
+        }
+        return nullptr;
+    }
+    if (memoryType >= MemoryTypesCount)
+        memoryType = MemoryTypesCount - 1;
+
+    const uint64 blockSize = size + sizeof(BlockHeader);
+    BlockHeader* header;
+    uint32 sizeClass = GetSizeClass(blockSize);
+    if (sizeClass < XBOX_LIVE_ALLOCATOR_CLASSES)
+    {
+        // Small allocation from the pool
+        ThreadCache& cache = GetCache();
+        if (!cache.FreeList[sizeClass] && !Refill(cache, sizeClass))
+        {
+            Platform::InterlockedAdd(&LiveBytes, -(int64)size);
+            return nullptr;
+        }
+        FreeBlock* block = cache.FreeList[sizeClass];
+        cache.FreeList[sizeClass] = block->Next;
+        cache.Count[sizeClass]--;
+        header = (BlockHeader*)block;
+    }
+    else
+    {
+        // Large allocation
+        sizeClass = XBOX_LIVE_ALLOCATOR_LARGE_CLASS;
+        header = (BlockHeader*)Allocator::Allocate(blockSize, 16);
+        if (!header)
+        {
+            Platform::InterlockedAdd(&LiveBytes, -(int64)size);
+            return nullptr;
+        }
+    }
+    header->SizeClass = sizeClass;
+    header->MemoryType = memoryType;
+    header->Size = size;
+
+    // Update stats
+    Platform::InterlockedAdd(&TypeLiveBytes[memoryType], (int64)size);
+    Platform::InterlockedIncrement(&Allocations);
+    UpdatePeak(live);
+
+    return header + 1;
+}
+
+void XboxLiveAllocator::Free(void* ptr)
+{
+    if (!ptr)
+        return;
+    BlockHeader* header = (BlockHeader*)ptr - 1;
+    const int64 size = (int64)header->Size;
+    Platform::InterlockedAdd(&TypeLiveBytes[header->MemoryType], -size);
+    const uint32 sizeClass = header->SizeClass;
+    if (sizeClass == XBOX_LIVE_ALLOCATOR_LARGE_CLASS)
+    {
+        Allocator::Free(header);
+    }
+    else
+    {
+        // Return block to the thread cache
+        ThreadCache& cache = GetCache();
+        auto block = (FreeBlock*)header;
+        block->Next = cache.FreeList[sizeClass];
+        cache.FreeList[sizeClass] = block;
+        cache.Count[sizeClass]++;
+        if (cache.Count[sizeClass] > XBOX_LIVE_ALLOCATOR_THREAD_CACHE_SIZE)
+            Flush(cache, sizeClass);
+    }
+
+    // Block is released from the live bytes once it's no longer touched (see Release)
+    Platform::InterlockedAdd(&LiveBytes, -size);
+}
+
+bool XboxLiveAllocator::Release()
+{
+    if (Platform::AtomicRead(&LiveBytes) != 0)
+        return true;
+
+    // Invalidate thread caches (with all pools locked so no thread can move blocks between its cache and the pools)
+    for (Pool& pool : Pools)
+        pool.Locker.Lock();
+    Platform::InterlockedIncrement(&Generation);
+
+    // Allocations reserve live bytes before touching the caches so any allocation that started in the meantime is visible here
+    const bool failed = Platform::AtomicRead(&LiveBytes) != 0;
+    if (!failed)
+    {
+        // Free chunks
+        for (Pool& pool : Pools)
+        {
+            while (pool.Chunks)
+            {
+                Chunk* chunk = pool.Chunks;
+                pool.Chunks = chunk->Next;
+                Allocator::Free(chunk);
+                Platform::InterlockedAdd(&ReservedBytes, -XBOX_LIVE_ALLOCATOR_CHUNK_SIZE);
+            }
+            pool.FreeList = nullptr;
+        }
+        BudgetWarning = false;
+    }
+    for (Pool& pool : Pools)
+        pool.Locker.Unlock();
+    return failed;
+}
+
+int64 XboxLiveAllocator::GetLiveBytes()
+{
+    return Platform::AtomicRead(&LiveBytes);
+}
+
+int64 XboxLiveAllocator::GetPeakBytes()
+{
+    return Platform::AtomicRead(&PeakBytes);
+}
+
+int64 XboxLiveAllocator::GetReservedBytes()
+{
+    return Platform::AtomicRead(&ReservedBytes);
+}
+
+int64 XboxLiveAllocator::GetAllocations()
+{
+    return Platform::AtomicRead(&Allocations);
+}
+
+int64 XboxLiveAllocator::GetLiveBytes(uint32 memoryType)
+{
+    if (memoryType >= MemoryTypesCount)
+        memoryType = MemoryTypesCount - 1;
+    return Platform::AtomicRead(&TypeLiveBytes[memoryType]);
+}
+
+int64 XboxLiveAllocator::GetBudget()
+{
+    return Platform::AtomicRead(&Budget);
+}
+
+void XboxLiveAllocator::SetBudget(int64 bytes)
+{
+    Platform::AtomicStore(&Budget, bytes > 0 ? bytes : 0);
+    BudgetWarning = false;
+}
+
+#endif
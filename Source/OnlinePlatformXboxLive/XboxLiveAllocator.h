@@ -0,0 +1,77 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#pragma once
+
+#if PLATFORM_GDK
+
+#include "Engine/Core/Types/BaseTypes.h"
+
+/// <summary>
+/// Memory allocator used by the Xbox Live SDK (XSAPI and libHttpClient) via memory hooks. Small allocations are served from size-class pools with per-thread caches to prevent fragmenting the game heap with many small and short-lived allocations (JSON, HTTP buffers).
+/// </summary>
+class XboxLiveAllocator
+{
+public:
+    /// <summary>
+    /// The amount of tracked memory types (HCMemoryType values above the limit are counted under the last one).
+    /// </summary>
+    static constexpr int32 MemoryTypesCount = 32;
+
+    /// <summary>
+    /// Allocates the memory block.
+    /// </summary>
+    /// <param name="size">The size (in bytes).</param>
+    /// <param name="memoryType">The SDK memory type (HCMemoryType).</param>
+    /// <returns>The allocated memory or null if failed (eg. over the budget).</returns>
+    static void* Allocate(uint64 size, uint32 memoryType);
+
+    /// <summary>
+    /// Frees the memory block.
+    /// </summary>
+    /// <param name="ptr">The memory allocated with Allocate.</param>
+    static void Free(void* ptr);
+
+    /// <summary>
+    /// Releases the memory reserved by the pools. Can be done only when all SDK allocations were freed (after SDK cleanup).
+    /// </summary>
+    /// <returns>True if failed (memory is still in use), otherwise false.</returns>
+    static bool Release();
+
+public:
+    /// <summary>
+    /// Gets the size of the currently allocated memory (in bytes).
+    /// </summary>
+    static int64 GetLiveBytes();
+
+    /// <summary>
+    /// Gets the peak size of the allocated memory (in bytes).
+    /// </summary>
+    static int64 GetPeakBytes();
+
+    /// <summary>
+    /// Gets the size of the memory reserved by the pools (in bytes).
+    /// </summary>
+    static int64 GetReservedBytes();
+
+    /// <summary>
+    /// Gets the total amount of the memory blocks allocated (since the engine start).
+    /// </summary>
+    static int64 GetAllocations();
+
+    /// <summary>
+    /// Gets the size of the currently allocated memory (in bytes) of the given SDK memory type.
+    /// </summary>
+    static int64 GetLiveBytes(uint32 memoryType);
+
+    /// <summary>
+    /// Gets the memory budget (in bytes). Allocations over the budget fail. Value 0 disables the limit.
+    /// </summary>
+    static int64 GetBudget();
+
+    /// <summary>
+    /// Sets the memory budget (in bytes). Allocations over the budget fail. Value 0 disables the limit.
+    /// </summary>
+    static void SetBudget(int64 bytes);
+};
+
+#endif
@@ -0,0 +1,380 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#if !BUILD_RELEASE
+
+#include "XboxLiveReplayBenchmark.h"
+#include "OnlinePlatformXboxLiveTrace.h"
+#if PLATFORM_GDK
+#include "OnlinePlatformXboxLive.h"
+#include "XboxLiveSimulatedService.h"
+#endif
+#include "Engine/Core/Log.h"
+#include "Engine/Core/Math/Math.h"
+#include "Engine/Core/Collections/Sorting.h"
+#include "Engine/Platform/Platform.h"
+#include "Engine/Platform/CriticalSection.h"
+#include "Engine/Platform/User.h"
+#include "Engine/Profiler/ProfilerCPU.h"
+#include "Engine/Serialization/MemoryWriteStream.h"
+#include "Engine/Threading/JobSystem.h"
+#include "Engine/Threading/Threading.h"
+
+#define XBOX_LIVE_REPLAY_BENCHMARK_SAVE_NAME TEXT("Benchmark")
+#define XBOX_LIVE_REPLAY_BENCHMARK_LEADERBOARD_NAME TEXT("Benchmark")
+#define XBOX_LIVE_REPLAY_BENCHMARK_STEADY_STATE_REQUESTS 100
+#if PLATFORM_GDK
+// Process the finished background tasks of the simulated platform (main thread is blocked by the benchmark so it doesn't update the platform)
+#define XBOX_LIVE_REPLAY_BENCHMARK_UPDATE() if (xboxLive) xboxLive->OnUpdate()
+#else
+#define XBOX_LIVE_REPLAY_BENCHMARK_UPDATE()
+#endif
+
+namespace
+{
+    // Results of the requests sent by a single local user
+    struct UserStats
+    {
+        int32 Failures = 0;
+        uint64 PeakMemory = 0;
+        Array<float> Latencies;
+    };
+
+    OnlineUser CreateUser(int32 index)
+    {
+        OnlineUser user;
+        user.Id = Guid(index + 1, 0, 0, 0x4C54);
+        user.Name = String::Format(TEXT("BenchmarkUser{0}"), index);
+        user.PresenceState = (OnlinePresenceStates)(index % 4);
+        return user;
+    }
+
+    OnlinePlatformXboxLiveTrace::Event CreateEvent(OnlinePlatformXboxLiveTrace::Ops op, const String& key, float latency, const MemoryWriteStream* payload = nullptr)
+    {
+        OnlinePlatformXboxLiveTrace::Event e;
+        e.Op = op;
+        e.Failed = false;
+        e.Pages = 1;
+        e.Time = 0.0f;
+        e.Duration = latency;
+        e.Key = key;
+        if (payload)
+            e.Payload.Set(payload->GetHandle(), (int32)payload->GetPosition());
+        return e;
+    }
+
+    float GetPercentile(const Array<float>& sorted, float percentile)
+    {
+        if (sorted.IsEmpty())
+            return 0.0f;
+        const int32 index = Math::Clamp((int32)Math::Ceil(percentile * (float)sorted.Count()) - 1, 0, sorted.Count() - 1);
+        return sorted[index];
+    }
+}
+
+Array<XboxLiveReplayBenchmarkScenario> XboxLiveReplayBenchmark::GetDefaultScenarios()
+{
+    Array<XboxLiveReplayBenchmarkScenario> scenarios;
+    const int32 users[] = { 1, 4, 8 };
+    const int32 friends[] = { 0, 200, 2000 };
+    for (const int32 usersCount : users)
+    {
+        for (const int32 friendsCount : friends)
+        {
+            auto& scenario = scenarios.AddOne();
+            scenario = XboxLiveReplayBenchmarkScenario();
+            scenario.Name = String::Format(TEXT("{0} users, {1} friends"), usersCount, friendsCount);
+            scenario.LocalUsers = usersCount;
+            scenario.Friends = friendsCount;
+        }
+    }
+    return scenarios;
+}
+
+OnlinePlatformXboxLiveTrace* XboxLiveReplayBenchmark::CreateBackend(const XboxLiveReplayBenchmarkScenario& scenario, int32 userIndex)
+{
+    PROFILE_CPU();
+    typedef OnlinePlatformXboxLiveTrace::Ops Ops;
+    auto backend = NewObject<OnlinePlatformXboxLiveTrace>();
+    backend->Mode = XboxLiveTraceModes::Replay;
+    const float latency = Math::Max(scenario.Latency, 0.0f);
+
+    // Friends (simulated local users are not registered so each of them uses a separate backend, friend lists are partially shared like in a social graph)
+    {
+        const int32 count = Math::Max(scenario.Friends, 0);
+        MemoryWriteStream stream(Math::Max(count * 64, 64));
+        stream.WriteInt32(count);
+        for (int32 i = 0; i < count; i++)
+            OnlinePlatformXboxLiveTrace::Write(stream, CreateUser(userIndex * (count / 2) + i));
+        backend->AddEvent(CreateEvent(Ops::GetFriends, OnlinePlatformXboxLiveTrace::GetKey(nullptr), latency, &stream));
+    }
+
+    // Leaderboard with all entries windows
+    {
+        OnlineLeaderboard leaderboard;
+        leaderboard.Identifier = XBOX_LIVE_REPLAY_BENCHMARK_LEADERBOARD_NAME;
+        leaderboard.Name = XBOX_LIVE_REPLAY_BENCHMARK_LEADERBOARD_NAME;
+        leaderboard.SortMode = OnlineLeaderboardSortModes::Descending;
+        leaderboard.ValueFormat = OnlineLeaderboardValueFormats::Numeric;
+        leaderboard.EntriesCount = Math::Max(scenario.LeaderboardRows, 0);
+        MemoryWriteStream stream(256);
+        OnlinePlatformXboxLiveTrace::Write(stream, leaderboard);
+        backend->AddEvent(CreateEvent(Ops::GetLeaderboard, OnlinePlatformXboxLiveTrace::GetKey(nullptr, leaderboard.Name), latency, &stream));
+
+        const int32 pageSize = Math::Max(scenario.LeaderboardPageSize, 1);
+        OnlineLeaderboardEntry entry;
+        for (int32 start = 0; start < leaderboard.EntriesCount; start += pageSize)
+        {
+            const int32 count = Math::Min(pageSize, leaderboard.EntriesCount - start);
+            stream.SetPosition(0);
+            stream.WriteInt32(count);
+            for (int32 i = 0; i < count; i++)
+            {
+                entry.User = CreateUser(start + i);
+                entry.Rank = start + i + 1;
+                entry.Score = leaderboard.EntriesCount - (start + i);
+                OnlinePlatformXboxLiveTrace::Write(stream, entry);
+            }
+            backend->AddEvent(CreateEvent(Ops::GetLeaderboardEntries, OnlinePlatformXboxLiveTrace::GetKey(nullptr, leaderboard.Name, start, pageSize), latency, &stream));
+        }
+    }
+
+    // Save game
+    if (scenario.SaveGameSize > 0)
+    {
+        MemoryWriteStream stream(scenario.SaveGameSize);
+        for (int32 i = 0; i < scenario.SaveGameSize; i++)
+            stream.WriteByte((byte)i);
+        backend->AddEvent(CreateEvent(Ops::GetSaveGame, OnlinePlatformXboxLiveTrace::GetKey(nullptr, XBOX_LIVE_REPLAY_BENCHMARK_SAVE_NAME), latency, &stream));
+        backend->AddEvent(CreateEvent(Ops::SetSaveGame, OnlinePlatformXboxLiveTrace::GetKey(nullptr, XBOX_LIVE_REPLAY_BENCHMARK_SAVE_NAME, scenario.SaveGameSize), latency));
+    }
+
+    return backend;
+}
+
+XboxLiveReplayBenchmarkResult XboxLiveReplayBenchmark::Run(const XboxLiveReplayBenchmarkScenario& scenario, IOnlinePlatform* platform)
+{
+    PROFILE_CPU();
+    XboxLiveReplayBenchmarkResult result;
+    result.Name = scenario.Name;
+    if (!IsInMainThread())
+    {
+        // Main thread updates the online platform so it has to wait for the benchmark end
+        LOG(Error, "Xbox Live replay benchmark has to be run on the main thread");
+        return result;
+    }
+
+    // Setup the platform
+    Array<OnlinePlatformXboxLiveTrace*> backends;
+    Array<User*> localUsers;
+    int32 usersCount = Math::Max(scenario.LocalUsers, 1);
+#if PLATFORM_GDK
+    OnlinePlatformXboxLive* xboxLive = nullptr;
+    if (!platform)
+    {
+        // Run the Xbox Live plugin against the simulated service
+        xboxLive = NewObject<OnlinePlatformXboxLive>();
+        xboxLive->Service = &XboxLiveSimulatedService::Begin(scenario);
+        if (xboxLive->Initialize())
+        {
+            LOG(Warning, "Failed to initialize Xbox Live with the simulated service, using the trace replay instead");
+            xboxLive->DeleteObjectNow();
+            xboxLive = nullptr;
+            XboxLiveSimulatedService::End();
+        }
+        else
+        {
+            for (int32 userIndex = 0; userIndex < usersCount; userIndex++)
+            {
+                User* localUser = XboxLiveSimulatedService::GetUser(userIndex);
+                xboxLive->UserLogin(localUser);
+                localUsers.Add(localUser);
+            }
+            platform = xboxLive;
+        }
+    }
+#endif
+    if (!platform)
+    {
+        // Replay the synthetic trace (separate backend for each simulated user)
+        for (int32 userIndex = 0; userIndex < usersCount; userIndex++)
+        {
+            OnlinePlatformXboxLiveTrace* backend = CreateBackend(scenario, userIndex);
+            if (backend->Initialize())
+            {
+                LOG(Error, "Failed to initialize Xbox Live replay benchmark backend");
+                backend->DeleteObjectNow();
+                for (OnlinePlatformXboxLiveTrace* e : backends)
+                {
+                    e->Deinitialize();
+                    e->DeleteObjectNow();
+                }
+                return result;
+            }
+            backends.Add(backend);
+            localUsers.Add(nullptr);
+        }
+    }
+    else if (localUsers.IsEmpty())
+    {
+        usersCount = Math::Min(usersCount, Platform::Users.Count());
+        if (usersCount == 0)
+        {
+            LOG(Error, "Missing local users to run Xbox Live replay benchmark");
+            return result;
+        }
+        localUsers.Add(Platform::Users.Get(), usersCount);
+    }
+
+    // Online platforms are not thread-safe so requests of all users to the shared platform are serialized (trace backends are separate for each user)
+    CriticalSection platformLocker;
+    CriticalSection* locker = backends.HasItems() ? nullptr : &platformLocker;
+    const int32 pageSize = Math::Max(scenario.LeaderboardPageSize, 1);
+    const int32 iterations = Math::Max(scenario.Iterations, 1);
+    Array<byte> saveData;
+    saveData.Resize(Math::Max(scenario.SaveGameSize, 0), false);
+    for (int32 i = 0; i < saveData.Count(); i++)
+        saveData[i] = (byte)i;
+    Array<UserStats> stats;
+    stats.Resize(usersCount);
+    const uint64 baseMemory = Platform::GetProcessMemoryStats().UsedPhysicalMemory;
+
+    // Run all local users concurrently
+    const double startTime = Platform::GetTimeSeconds();
+    const Function<void(int32)> job = [&](int32 userIndex)
+    {
+        PROFILE_CPU_NAMED("Xbox Live Replay Benchmark");
+        IOnlinePlatform* userPlatform = backends.HasItems() ? backends[userIndex] : platform;
+        User* localUser = localUsers[userIndex];
+        UserStats& userStats = stats[userIndex];
+        userStats.Latencies.EnsureCapacity(iterations * 3 + 1);
+        Array<OnlineUser, HeapAllocation> friends;
+        Array<OnlineLeaderboardEntry, HeapAllocation> entries;
+        Array<byte, HeapAllocation> data;
+        OnlineLeaderboard leaderboard;
+        double time;
+        bool failed;
+#define XBOX_LIVE_REPLAY_BENCHMARK_REQUEST(request) \
+            time = Platform::GetTimeSeconds(); \
+            if (locker) \
+                locker->Lock(); \
+            failed = request; \
+            XBOX_LIVE_REPLAY_BENCHMARK_UPDATE(); \
+            if (locker) \
+                locker->Unlock(); \
+            if (failed) \
+                userStats.Failures++; \
+            userStats.Latencies.Add((float)((Platform::GetTimeSeconds() - time) * 1000.0)); \
+            userStats.PeakMemory = Math::Max(userStats.PeakMemory, Platform::GetProcessMemoryStats().UsedPhysicalMemory)
+        XBOX_LIVE_REPLAY_BENCHMARK_REQUEST(userPlatform->GetLeaderboard(XBOX_LIVE_REPLAY_BENCHMARK_LEADERBOARD_NAME, leaderboard, localUser));
+        const int32 windows = Math::Max(leaderboard.EntriesCount + pageSize - 1, 0) / pageSize;
+        for (int32 iteration = 0; iteration < iterations; iteration++)
+        {
+            XBOX_LIVE_REPLAY_BENCHMARK_REQUEST(userPlatform->GetFriends(friends, localUser));
+            if (windows > 0)
+            {
+                // Spread users over the leaderboard
+                const int32 window = (iteration * usersCount + userIndex) % windows;
+                XBOX_LIVE_REPLAY_BENCHMARK_REQUEST(userPlatform->GetLeaderboardEntries(leaderboard, entries, window * pageSize, pageSize));
+            }
+            if (saveData.HasItems())
+            {
+                if (iteration % 2 == 0)
+                {
+                    XBOX_LIVE_REPLAY_BENCHMARK_REQUEST(userPlatform->SetSaveGame(XBOX_LIVE_REPLAY_BENCHMARK_SAVE_NAME, Span<byte>(saveData.Get(), saveData.Count()), localUser));
+                }
+                else
+                {
+                    XBOX_LIVE_REPLAY_BENCHMARK_REQUEST(userPlatform->GetSaveGame(XBOX_LIVE_REPLAY_BENCHMARK_SAVE_NAME, data, localUser));
+                }
+            }
+        }
+#undef XBOX_LIVE_REPLAY_BENCHMARK_REQUEST
+    };
+    JobSystem::Wait(JobSystem::Dispatch(job, usersCount));
+    result.Duration = (float)(Platform::GetTimeSeconds() - startTime);
+
+    // Gather results
+    Array<float> latencies;
+    uint64 peakMemory = baseMemory;
+    for (const UserStats& userStats : stats)
+    {
+        result.Failures += userStats.Failures;
+        latencies.Add(userStats.Latencies);
+        peakMemory = Math::Max(peakMemory, userStats.PeakMemory);
+    }
+    Sorting::QuickSort(latencies.Get(), latencies.Count());
+    result.Requests = latencies.Count();
+    result.Throughput = result.Duration > 0.0f ? (float)result.Requests / result.Duration : 0.0f;
+    result.LatencyP50 = GetPercentile(latencies, 0.50f);
+    result.LatencyP95 = GetPercentile(latencies, 0.95f);
+    result.LatencyP99 = GetPercentile(latencies, 0.99f);
+    result.PeakMemory = (int64)(peakMemory - baseMemory);
+
+#if PLATFORM_GDK
+    // Steady-state requests (served from the caches) shouldn't allocate memory in the plugin nor in the SDK
+    OnlinePlatformXboxLive* xboxLivePlatform = OnlinePlatformXboxLive::GetInstance();
+    if (backends.IsEmpty() && xboxLivePlatform && platform == static_cast<IOnlinePlatform*>(xboxLivePlatform))
+    {
+        PROFILE_CPU_NAMED("Xbox Live Steady State");
+        User* localUser = localUsers[0];
+        OnlineLeaderboard leaderboard;
+        Array<OnlineLeaderboardEntry, HeapAllocation> entries;
+        if (!xboxLivePlatform->GetLeaderboard(XBOX_LIVE_REPLAY_BENCHMARK_LEADERBOARD_NAME, leaderboard, localUser) &&
+            !xboxLivePlatform->GetLeaderboardEntries(leaderboard, entries, 0, pageSize))
+        {
+            // Wait for the background tasks (eg. leaderboard prefetch) started by the warm-up
+            const double timeout = Platform::GetTimeSeconds() + 10.0;
+            xboxLivePlatform->OnUpdate();
+            while (xboxLivePlatform->GetDispatchStats().PendingTasks != 0 && Platform::GetTimeSeconds() < timeout)
+            {
+                Platform::Sleep(1);
+                xboxLivePlatform->OnUpdate();
+            }
+
+            const XboxLiveMemoryStats before = xboxLivePlatform->GetMemoryStats();
+            for (int32 i = 0; i < XBOX_LIVE_REPLAY_BENCHMARK_STEADY_STATE_REQUESTS; i++)
+            {
+                xboxLivePlatform->GetLeaderboard(XBOX_LIVE_REPLAY_BENCHMARK_LEADERBOARD_NAME, leaderboard, localUser);
+                xboxLivePlatform->GetLeaderboardEntries(leaderboard, entries, 0, pageSize);
+                xboxLivePlatform->OnUpdate();
+            }
+            const XboxLiveMemoryStats after = xboxLivePlatform->GetMemoryStats();
+            result.SteadyStateAllocations = (after.Allocations - before.Allocations) + (after.ScratchAllocations - before.ScratchAllocations);
+            if (result.SteadyStateAllocations != 0)
+                LOG(Error, "Xbox Live steady-state requests made {0} allocations in {1} requests ({2} in SDK)", result.SteadyStateAllocations, XBOX_LIVE_REPLAY_BENCHMARK_STEADY_STATE_REQUESTS * 2, after.Allocations - before.Allocations);
+        }
+    }
+#endif
+
+    for (OnlinePlatformXboxLiveTrace* backend : backends)
+    {
+        backend->Deinitialize();
+        backend->DeleteObjectNow();
+    }
+#if PLATFORM_GDK
+    if (xboxLive)
+    {
+        for (User* localUser : localUsers)
+            xboxLive->UserLogout(localUser);
+        xboxLive->Deinitialize();
+        xboxLive->DeleteObjectNow();
+        XboxLiveSimulatedService::End();
+    }
+#endif
+    return result;
+}
+
+void XboxLiveReplayBenchmark::RunDefault()
+{
+    PROFILE_CPU();
+    LOG(Info, "Running Xbox Live replay benchmark");
+    for (const XboxLiveReplayBenchmarkScenario& scenario : GetDefaultScenarios())
+    {
+        const XboxLiveReplayBenchmarkResult result = Run(scenario);
+        LOG(Info, "{0}: {1} requests ({2} failed) in {3}s, {4} requests/s, latency p50 {5}ms, p95 {6}ms, p99 {7}ms, peak memory {8} kB, steady-state allocations {9}",
+            result.Name, result.Requests, result.Failures, result.Duration, result.Throughput,
+            result.LatencyP50, result.LatencyP95, result.LatencyP99, result.PeakMemory / 1024, result.SteadyStateAllocations);
+    }
+}
+
+#endif
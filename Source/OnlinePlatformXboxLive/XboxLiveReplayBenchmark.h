@@ -0,0 +1,155 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#pragma once
+
+#if !BUILD_RELEASE
+
+#include "Engine/Core/Types/String.h"
+#include "Engine/Core/Collections/Array.h"
+#include "Engine/Scripting/ScriptingType.h"
+
+class IOnlinePlatform;
+class OnlinePlatformXboxLiveTrace;
+
+/// <summary>
+/// The online services replay benchmark scenario.
+/// </summary>
+API_STRUCT(NoDefault, Namespace="FlaxEngine.Online.XboxLive") struct ONLINEPLATFORMXBOXLIVE_API XboxLiveReplayBenchmarkScenario
+{
+    DECLARE_SCRIPTING_TYPE_MINIMAL(XboxLiveReplayBenchmarkScenario);
+
+    /// <summary>
+    /// The scenario name.
+    /// </summary>
+    API_FIELD() String Name;
+
+    /// <summary>
+    /// The amount of simulated local users (each sends requests concurrently).
+    /// </summary>
+    API_FIELD() int32 LocalUsers = 1;
+
+    /// <summary>
+    /// The amount of friends of each user.
+    /// </summary>
+    API_FIELD() int32 Friends = 100;
+
+    /// <summary>
+    /// The amount of rows in the leaderboard.
+    /// </summary>
+    API_FIELD() int32 LeaderboardRows = 10000;
+
+    /// <summary>
+    /// The amount of leaderboard rows read per request.
+    /// </summary>
+    API_FIELD() int32 LeaderboardPageSize = 100;
+
+    /// <summary>
+    /// The size (in bytes) of the save game written and read by each user. Use 0 to skip save game traffic.
+    /// </summary>
+    API_FIELD() int32 SaveGameSize = 64 * 1024;
+
+    /// <summary>
+    /// The amount of iterations (friends, leaderboard and save game requests) done by each user.
+    /// </summary>
+    API_FIELD() int32 Iterations = 50;
+
+    /// <summary>
+    /// The latency (in seconds) of the requests to the simulated service.
+    /// </summary>
+    API_FIELD() float Latency = 0.02f;
+};
+
+/// <summary>
+/// The online services replay benchmark scenario results.
+/// </summary>
+API_STRUCT(NoDefault, Namespace="FlaxEngine.Online.XboxLive") struct ONLINEPLATFORMXBOXLIVE_API XboxLiveReplayBenchmarkResult
+{
+    DECLARE_SCRIPTING_TYPE_MINIMAL(XboxLiveReplayBenchmarkResult);
+
+    /// <summary>
+    /// The scenario name.
+    /// </summary>
+    API_FIELD() String Name;
+
+    /// <summary>
+    /// The amount of sent requests.
+    /// </summary>
+    API_FIELD() int32 Requests = 0;
+
+    /// <summary>
+    /// The amount of failed requests.
+    /// </summary>
+    API_FIELD() int32 Failures = 0;
+
+    /// <summary>
+    /// The total scenario time (in seconds).
+    /// </summary>
+    API_FIELD() float Duration = 0.0f;
+
+    /// <summary>
+    /// The amount of requests handled per second.
+    /// </summary>
+    API_FIELD() float Throughput = 0.0f;
+
+    /// <summary>
+    /// The median request latency (in milliseconds).
+    /// </summary>
+    API_FIELD() float LatencyP50 = 0.0f;
+
+    /// <summary>
+    /// The 95th percentile of request latency (in milliseconds).
+    /// </summary>
+    API_FIELD() float LatencyP95 = 0.0f;
+
+    /// <summary>
+    /// The 99th percentile of request latency (in milliseconds).
+    /// </summary>
+    API_FIELD() float LatencyP99 = 0.0f;
+
+    /// <summary>
+    /// The peak growth (in bytes) of the process memory during the scenario.
+    /// </summary>
+    API_FIELD() int64 PeakMemory = 0;
+
+    /// <summary>
+    /// The amount of allocations (Xbox Live SDK and plugin buffers, see XboxLiveMemoryStats) made by the repeated steady-state requests (cached leaderboard reads) after the scenario. Expected to be 0. Measured only when running the Xbox Live plugin.
+    /// </summary>
+    API_FIELD() int64 SteadyStateAllocations = 0;
+};
+
+/// <summary>
+/// The benchmark of the online services usage at scale (many local users, large friend lists and leaderboards, concurrent save games). Not available in release builds.
+/// By default, runs the OnlinePlatformXboxLive against the simulated Xbox Live service (see XboxLiveSimulatedService) so it measures the plugin code (task queue, callbacks, caching and batching) with the simulated service latency. On platforms without Xbox Live (or when the plugin is already used by the game) it replays the synthetic trace (see OnlinePlatformXboxLiveTrace) at the IOnlinePlatform level instead, which measures only the game-side usage. Requests of all users to the same platform are serialized as online platforms are not thread-safe.
+/// </summary>
+API_CLASS(Static, Namespace="FlaxEngine.Online.XboxLive") class ONLINEPLATFORMXBOXLIVE_API XboxLiveReplayBenchmark
+{
+    DECLARE_SCRIPTING_TYPE_MINIMAL(XboxLiveReplayBenchmark);
+public:
+    /// <summary>
+    /// Gets the default scenarios (1-8 local users, 0-2000 friends, 10k rows leaderboard with concurrent save games).
+    /// </summary>
+    API_FUNCTION() static Array<XboxLiveReplayBenchmarkScenario> GetDefaultScenarios();
+
+    /// <summary>
+    /// Creates the trace replay backend for the scenario (replays the synthetic trace). Used when Xbox Live plugin can't run against the simulated service. Returned object has to be deleted by the caller.
+    /// </summary>
+    /// <param name="scenario">The scenario.</param>
+    /// <param name="userIndex">The index of the simulated local user. Each simulated user has a separate backend with its own friends and requests order.</param>
+    /// <returns>The online platform (not initialized).</returns>
+    API_FUNCTION() static OnlinePlatformXboxLiveTrace* CreateBackend(API_PARAM(Ref) const XboxLiveReplayBenchmarkScenario& scenario, int32 userIndex = 0);
+
+    /// <summary>
+    /// Runs the benchmark scenario. Has to be called on the main thread.
+    /// </summary>
+    /// <param name="scenario">The scenario.</param>
+    /// <param name="platform">The online platform to test (must be initialized, uses local users from Platform::Users). Null to use the simulated service. Uses leaderboard and save game named Benchmark.</param>
+    /// <returns>The results.</returns>
+    API_FUNCTION() static XboxLiveReplayBenchmarkResult Run(API_PARAM(Ref) const XboxLiveReplayBenchmarkScenario& scenario, IOnlinePlatform* platform = nullptr);
+
+    /// <summary>
+    /// Runs all default scenarios on the simulated service and prints results to the log.
+    /// </summary>
+    API_FUNCTION() static void RunDefault();
+};
+
+#endif
@@ -0,0 +1,69 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#pragma once
+
+#if PLATFORM_GDK
+
+#include "Engine/Platform/Win32/IncludeWindowsHeaders.h"
+#include <XGameRuntime.h>
+#include <xsapi-c/services_c.h>
+
+/// <summary>
+/// The table of Xbox Live functions used by OnlinePlatformXboxLive for the SDK initialization, user contexts, friends, profiles, leaderboards and save games. Defaults to the Xbox Live SDK (see GetDefault), can be replaced with a simulated service (eg. by XboxLiveReplayBenchmark) to run the plugin code without Xbox Live.
+/// Async functions have to complete the XAsyncBlock on its task queue like the SDK does (eg. with XAsyncBegin and XAsyncComplete).
+/// </summary>
+struct XboxLiveService
+{
+    // SDK
+    HRESULT (*Initialize)(const XblInitArgs* args);
+    HRESULT (*CleanupAsync)(XAsyncBlock* async);
+    HRESULT (*GetScid)(const char** scid);
+
+    // Users
+    HRESULT (*UserGetLocalId)(XUserHandle user, XUserLocalId* userLocalId);
+    HRESULT (*UserGetGamertag)(XUserHandle user, XUserGamertagComponent gamertagComponent, size_t gamertagSize, char* gamertag, size_t* gamertagUsed);
+    HRESULT (*UserRegisterForChangeEvent)(XTaskQueueHandle queue, void* context, XUserChangeEventCallback* callback, XTaskQueueRegistrationToken* token);
+    HRESULT (*ContextCreateHandle)(XUserHandle user, XblContextHandle* context);
+    HRESULT (*ContextDuplicateHandle)(XblContextHandle context, XblContextHandle* duplicatedHandle);
+    void (*ContextCloseHandle)(XblContextHandle context);
+    HRESULT (*ContextGetXboxUserId)(XblContextHandle context, uint64_t* xboxUserId);
+
+    // Friends
+    HRESULT (*SocialGetSocialRelationshipsAsync)(XblContextHandle context, uint64_t xboxUserId, XblSocialRelationshipFilter filter, size_t startIndex, size_t maxItems, XAsyncBlock* async);
+    HRESULT (*SocialGetSocialRelationshipsResult)(XAsyncBlock* async, XblSocialRelationshipResultHandle* handle);
+    HRESULT (*SocialRelationshipResultGetRelationships)(XblSocialRelationshipResultHandle handle, const XblSocialRelationship** relationships, size_t* relationshipsCount);
+    HRESULT (*SocialRelationshipResultHasNext)(XblSocialRelationshipResultHandle handle, bool* hasNext);
+    HRESULT (*SocialRelationshipResultGetNextAsync)(XblContextHandle context, XblSocialRelationshipResultHandle handle, size_t maxItems, XAsyncBlock* async);
+    HRESULT (*SocialRelationshipResultGetNextResult)(XAsyncBlock* async, XblSocialRelationshipResultHandle* handle);
+    void (*SocialRelationshipResultCloseHandle)(XblSocialRelationshipResultHandle handle);
+    HRESULT (*ProfileGetUserProfilesAsync)(XblContextHandle context, const uint64_t* xboxUserIds, size_t xboxUserIdsCount, XAsyncBlock* async);
+    HRESULT (*ProfileGetUserProfilesResultCount)(XAsyncBlock* async, size_t* profileCount);
+    HRESULT (*ProfileGetUserProfilesResult)(XAsyncBlock* async, size_t profilesCount, XblUserProfile* profiles);
+
+    // Leaderboards
+    HRESULT (*LeaderboardGetLeaderboardAsync)(XblContextHandle context, XblLeaderboardQuery query, XAsyncBlock* async);
+    HRESULT (*LeaderboardGetLeaderboardResultSize)(XAsyncBlock* async, size_t* resultSizeInBytes);
+    HRESULT (*LeaderboardGetLeaderboardResult)(XAsyncBlock* async, size_t bufferSize, void* buffer, XblLeaderboardResult** ptrToBuffer, size_t* bufferUsed);
+
+    // Save games
+    HRESULT (*GameSaveInitializeProviderAsync)(XUserHandle user, const char* configurationId, bool syncOnDemand, XAsyncBlock* async);
+    HRESULT (*GameSaveInitializeProviderResult)(XAsyncBlock* async, XGameSaveProviderHandle* provider);
+    void (*GameSaveCloseProvider)(XGameSaveProviderHandle provider);
+    HRESULT (*GameSaveGetContainerInfo)(XGameSaveProviderHandle provider, const char* containerName, void* context, XGameSaveContainerInfoCallback* callback);
+    HRESULT (*GameSaveCreateContainer)(XGameSaveProviderHandle provider, const char* containerName, XGameSaveContainerHandle* container);
+    void (*GameSaveCloseContainer)(XGameSaveContainerHandle container);
+    HRESULT (*GameSaveEnumerateBlobInfo)(XGameSaveContainerHandle container, void* context, XGameSaveBlobInfoCallback* callback);
+    HRESULT (*GameSaveReadBlobData)(XGameSaveContainerHandle container, const char** blobNames, uint32_t* countOfBlobs, size_t blobsSize, XGameSaveBlob* blobData);
+    HRESULT (*GameSaveCreateUpdate)(XGameSaveContainerHandle container, const char* containerDisplayName, XGameSaveUpdateHandle* update);
+    void (*GameSaveCloseUpdate)(XGameSaveUpdateHandle update);
+    HRESULT (*GameSaveSubmitBlobWrite)(XGameSaveUpdateHandle update, const char* blobName, const uint8_t* data, size_t byteCount);
+    HRESULT (*GameSaveSubmitBlobDelete)(XGameSaveUpdateHandle update, const char* blobName);
+    HRESULT (*GameSaveSubmitUpdate)(XGameSaveUpdateHandle update);
+
+    /// <summary>
+    /// Gets the functions table that uses the Xbox Live SDK.
+    /// </summary>
+    static const XboxLiveService& GetDefault();
+};
+
+#endif
@@ -0,0 +1,636 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#if PLATFORM_GDK && !BUILD_RELEASE
+
+#include "XboxLiveSimulatedService.h"
+#include "XboxLiveService.h"
+#include "XboxLiveReplayBenchmark.h"
+#include "Engine/Core/Math/Math.h"
+#include "Engine/Core/Memory/Memory.h"
+#include "Engine/Core/Collections/Array.h"
+#include "Engine/Core/Collections/Dictionary.h"
+#include "Engine/Core/Types/StringView.h"
+#include "Engine/Platform/Platform.h"
+#include "Engine/Platform/CriticalSection.h"
+#include "Engine/Platform/User.h"
+#include <XAsyncProvider.h>
+#include <stdio.h>
+
+// Xbox user identifiers of the simulated local users and of the other users (friends and leaderboard rows)
+#define XBOX_LIVE_SIMULATED_LOCAL_XUID 0x0009000000000000ull
+#define XBOX_LIVE_SIMULATED_USER_XUID 0x0009100000000000ull
+#define XBOX_LIVE_SIMULATED_LOCAL_ID 0x4C540000ull
+// The default amount of items per page (when request doesn't specify it)
+#define XBOX_LIVE_SIMULATED_PAGE_SIZE 100
+// The space reserved for the formatted leaderboard score
+#define XBOX_LIVE_SIMULATED_VALUE_SIZE 16
+
+namespace
+{
+    struct SimulatedState
+    {
+        XboxLiveService Service;
+        uint32 Latency = 0;
+        int32 Friends = 0;
+        int32 LeaderboardRows = 0;
+        volatile int64 Contexts = 0;
+        CriticalSection Locker;
+        Array<User*> Users;
+    };
+
+    SimulatedState State;
+
+    // Page of the friends list (XblSocialRelationshipResultHandle)
+    struct SocialPage
+    {
+        uint64 XboxUserId;
+        int32 Start;
+        bool HasNext;
+        Array<XblSocialRelationship> Relationships;
+    };
+
+    // Save game storage of the user (XGameSaveProviderHandle)
+    struct SaveProvider
+    {
+        Dictionary<StringAnsi, Dictionary<StringAnsi, Array<byte>>> Containers;
+    };
+
+    // XGameSaveContainerHandle
+    struct SaveContainer
+    {
+        SaveProvider* Provider;
+        StringAnsi Name;
+    };
+
+    // XGameSaveUpdateHandle
+    struct SaveUpdate
+    {
+        SaveContainer* Container;
+        Dictionary<StringAnsi, Array<byte>> Writes;
+        Array<StringAnsi> Deletes;
+    };
+
+    // The async request in flight
+    struct Request
+    {
+        enum class Types
+        {
+            Cleanup,
+            Social,
+            Profiles,
+            Leaderboard,
+            SaveProvider,
+        };
+
+        Types Type;
+        // Results (owned by the request until they're taken by the caller)
+        SocialPage* Page = nullptr;
+        SaveProvider* Provider = nullptr;
+        Array<XblUserProfile> Profiles;
+        StringAnsi StatName;
+        Array<uint32> Ranks;
+
+        ~Request()
+        {
+            if (Page)
+                Delete(Page);
+            if (Provider)
+                Delete(Provider);
+        }
+
+        size_t GetResultSize() const
+        {
+            switch (Type)
+            {
+            case Types::Social:
+                return sizeof(XblSocialRelationshipResultHandle);
+            case Types::Profiles:
+                return Profiles.Count() * sizeof(XblUserProfile);
+            case Types::Leaderboard:
+                return sizeof(XblLeaderboardResult) + sizeof(XblLeaderboardColumn) + Ranks.Count() * (sizeof(XblLeaderboardRow) + sizeof(const char*) + XBOX_LIVE_SIMULATED_VALUE_SIZE) + StatName.Length() + 1;
+            case Types::SaveProvider:
+                return sizeof(XGameSaveProviderHandle);
+            default:
+                return 0;
+            }
+        }
+
+        void GetResult(void* buffer, size_t bufferSize);
+    };
+
+    uint64 GetXboxUserId(XblContextHandle context)
+    {
+        return XBOX_LIVE_SIMULATED_LOCAL_XUID + (uintptr)context - 1;
+    }
+
+    uint64 GetUserIndex(uint64 xboxUserId)
+    {
+        return xboxUserId - XBOX_LIVE_SIMULATED_USER_XUID;
+    }
+
+    // Gets the index of the first friend of the local user (friend lists are partially shared like in a social graph)
+    int32 GetFriendsStart(uint64 xboxUserId)
+    {
+        return (int32)(xboxUserId - XBOX_LIVE_SIMULATED_LOCAL_XUID) * (State.Friends / 2);
+    }
+
+    void SetUserName(char* name, size_t size, uint64 xboxUserId)
+    {
+        snprintf(name, size, "BenchmarkUser%llu", (unsigned long long)GetUserIndex(xboxUserId));
+    }
+
+    void Request::GetResult(void* buffer, size_t bufferSize)
+    {
+        switch (Type)
+        {
+        case Types::Social:
+            *(XblSocialRelationshipResultHandle*)buffer = (XblSocialRelationshipResultHandle)Page;
+            Page = nullptr;
+            break;
+        case Types::Profiles:
+            Platform::MemoryCopy(buffer, Profiles.Get(), Profiles.Count() * sizeof(XblUserProfile));
+            break;
+        case Types::Leaderboard:
+        {
+            // Layout the result like the SDK does: result, columns, rows, values pointers, values and strings
+            Platform::MemoryClear(buffer, bufferSize);
+            byte* ptr = (byte*)buffer;
+            auto result = (XblLeaderboardResult*)ptr;
+            ptr += sizeof(XblLeaderboardResult);
+            auto column = (XblLeaderboardColumn*)ptr;
+            ptr += sizeof(XblLeaderboardColumn);
+            auto rows = (XblLeaderboardRow*)ptr;
+            ptr += Ranks.Count() * sizeof(XblLeaderboardRow);
+            auto values = (const char**)ptr;
+            ptr += Ranks.Count() * sizeof(const char*);
+            char* strings = (char*)ptr;
+            result->totalRowCount = (uint32)State.LeaderboardRows;
+            result->columns = column;
+            result->columnsCount = 1;
+            result->rows = rows;
+            result->rowsCount = Ranks.Count();
+            result->hasNext = false;
+            column->statType = XblLeaderboardStatType::Int64;
+            for (int32 i = 0; i < Ranks.Count(); i++)
+            {
+                const uint32 rank = Ranks[i];
+                XblLeaderboardRow& row = rows[i];
+                row.xboxUserId = XBOX_LIVE_SIMULATED_USER_XUID + rank - 1;
+                SetUserName(row.gamertag, ARRAY_COUNT(row.gamertag), row.xboxUserId);
+                SetUserName(row.modernGamertag, ARRAY_COUNT(row.modernGamertag), row.xboxUserId);
+                row.rank = (uint32)i + 1;
+                row.globalRank = rank;
+                row.percentile = (double)rank / (double)Math::Max(State.LeaderboardRows, 1);
+                snprintf(strings, XBOX_LIVE_SIMULATED_VALUE_SIZE, "%d", State.LeaderboardRows - (int32)rank + 1);
+                values[i] = strings;
+                strings += XBOX_LIVE_SIMULATED_VALUE_SIZE;
+                row.columnValues = values + i;
+                row.columnValuesCount = 1;
+            }
+            Platform::MemoryCopy(strings, StatName.Get(), StatName.Length());
+            column->statName = strings;
+            break;
+        }
+        case Types::SaveProvider:
+            *(XGameSaveProviderHandle*)buffer = (XGameSaveProviderHandle)Provider;
+            Provider = nullptr;
+            break;
+        default:
+            break;
+        }
+    }
+
+    HRESULT CALLBACK OnRequest(XAsyncOp op, const XAsyncProviderData* data)
+    {
+        auto request = (Request*)data->context;
+        switch (op)
+        {
+        case XAsyncOp::DoWork:
+            XAsyncComplete(data->async, S_OK, request->GetResultSize());
+            break;
+        case XAsyncOp::GetResult:
+            request->GetResult(data->buffer, data->bufferSize);
+            break;
+        case XAsyncOp::Cancel:
+            XAsyncComplete(data->async, E_ABORT, 0);
+            break;
+        case XAsyncOp::Cleanup:
+            Delete(request);
+            break;
+        default:
+            break;
+        }
+        return S_OK;
+    }
+
+    // Starts the request that completes after the simulated latency on the task queue of the async block
+    HRESULT BeginRequest(XAsyncBlock* async, const void* identity, Request* request)
+    {
+        HRESULT result = XAsyncBegin(async, request, identity, nullptr, OnRequest);
+        if (FAILED(result))
+        {
+            Delete(request);
+            return result;
+        }
+        result = XAsyncSchedule(async, State.Latency);
+        if (FAILED(result))
+            XAsyncComplete(async, result, 0);
+        return S_OK;
+    }
+
+    SocialPage* CreateSocialPage(uint64 xboxUserId, int32 start, size_t maxItems)
+    {
+        auto page = New<SocialPage>();
+        page->XboxUserId = xboxUserId;
+        page->Start = Math::Min(start, State.Friends);
+        const int32 count = Math::Min(maxItems != 0 ? (int32)maxItems : XBOX_LIVE_SIMULATED_PAGE_SIZE, State.Friends - page->Start);
+        page->HasNext = page->Start + count < State.Friends;
+        page->Relationships.Resize(count);
+        Platform::MemoryClear(page->Relationships.Get(), count * sizeof(XblSocialRelationship));
+        const int32 friendsStart = GetFriendsStart(xboxUserId);
+        for (int32 i = 0; i < count; i++)
+            page->Relationships[i].xboxUserId = XBOX_LIVE_SIMULATED_USER_XUID + friendsStart + page->Start + i;
+        return page;
+    }
+
+    HRESULT Initialize(const XblInitArgs* args)
+    {
+        return S_OK;
+    }
+
+    HRESULT CleanupAsync(XAsyncBlock* async)
+    {
+        auto request = New<Request>();
+        request->Type = Request::Types::Cleanup;
+        return BeginRequest(async, (const void*)CleanupAsync, request);
+    }
+
+    HRESULT GetScid(const char** scid)
+    {
+        *scid = "00000000-0000-0000-0000-000000000000";
+        return S_OK;
+    }
+
+    HRESULT UserGetLocalId(XUserHandle user, XUserLocalId* userLocalId)
+    {
+        // Simulated users don't get the system user change events
+        return E_NOTIMPL;
+    }
+
+    HRESULT UserGetGamertag(XUserHandle user, XUserGamertagComponent gamertagComponent, size_t gamertagSize, char* gamertag, size_t* gamertagUsed)
+    {
+        const int32 length = snprintf(gamertag, gamertagSize, "BenchmarkLocalUser");
+        if (gamertagUsed)
+            *gamertagUsed = (size_t)length + 1;
+        return S_OK;
+    }
+
+    HRESULT UserRegisterForChangeEvent(XTaskQueueHandle queue, void* context, XUserChangeEventCallback* callback, XTaskQueueRegistrationToken* token)
+    {
+        token->token = 0;
+        return S_OK;
+    }
+
+    HRESULT ContextCreateHandle(XUserHandle user, XblContextHandle* context)
+    {
+        *context = (XblContextHandle)(uintptr)Platform::InterlockedIncrement(&State.Contexts);
+        return S_OK;
+    }
+
+    HRESULT ContextDuplicateHandle(XblContextHandle context, XblContextHandle* duplicatedHandle)
+    {
+        *duplicatedHandle = context;
+        return S_OK;
+    }
+
+    void ContextCloseHandle(XblContextHandle context)
+    {
+    }
+
+    HRESULT ContextGetXboxUserId(XblContextHandle context, uint64_t* xboxUserId)
+    {
+        *xboxUserId = GetXboxUserId(context);
+        return S_OK;
+    }
+
+    HRESULT SocialGetSocialRelationshipsAsync(XblContextHandle context, uint64_t xboxUserId, XblSocialRelationshipFilter filter, size_t startIndex, size_t maxItems, XAsyncBlock* async)
+    {
+        auto request = New<Request>();
+        request->Type = Request::Types::Social;
+        request->Page = CreateSocialPage(xboxUserId, (int32)startIndex, maxItems);
+        return BeginRequest(async, (const void*)SocialGetSocialRelationshipsAsync, request);
+    }
+
+    HRESULT SocialGetSocialRelationshipsResult(XAsyncBlock* async, XblSocialRelationshipResultHandle* handle)
+    {
+        return XAsyncGetResult(async, (const void*)SocialGetSocialRelationshipsAsync, sizeof(XblSocialRelationshipResultHandle), handle, nullptr);
+    }
+
+    HRESULT SocialRelationshipResultGetRelationships(XblSocialRelationshipResultHandle handle, const XblSocialRelationship** relationships, size_t* relationshipsCount)
+    {
+        const auto page = (SocialPage*)handle;
+        *relationships = page->Relationships.Get();
+        *relationshipsCount = page->Relationships.Count();
+        return S_OK;
+    }
+
+    HRESULT SocialRelationshipResultHasNext(XblSocialRelationshipResultHandle handle, bool* hasNext)
+    {
+        *hasNext = ((SocialPage*)handle)->HasNext;
+        return S_OK;
+    }
+
+    HRESULT SocialRelationshipResultGetNextAsync(XblContextHandle context, XblSocialRelationshipResultHandle handle, size_t maxItems, XAsyncBlock* async)
+    {
+        const auto page = (SocialPage*)handle;
+        auto request = New<Request>();
+        request->Type = Request::Types::Social;
+        request->Page = CreateSocialPage(page->XboxUserId, page->Start + page->Relationships.Count(), maxItems);
+        return BeginRequest(async, (const void*)SocialRelationshipResultGetNextAsync, request);
+    }
+
+    HRESULT SocialRelationshipResultGetNextResult(XAsyncBlock* async, XblSocialRelationshipResultHandle* handle)
+    {
+        return XAsyncGetResult(async, (const void*)SocialRelationshipResultGetNextAsync, sizeof(XblSocialRelationshipResultHandle), handle, nullptr);
+    }
+
+    void SocialRelationshipResultCloseHandle(XblSocialRelationshipResultHandle handle)
+    {
+        Delete((SocialPage*)handle);
+    }
+
+    HRESULT ProfileGetUserProfilesAsync(XblContextHandle context, const uint64_t* xboxUserIds, size_t xboxUserIdsCount, XAsyncBlock* async)
+    {
+        auto request = New<Request>();
+        request->Type = Request::Types::Profiles;
+        request->Profiles.Resize((int32)xboxUserIdsCount);
+        Platform::MemoryClear(request->Profiles.Get(), xboxUserIdsCount * sizeof(XblUserProfile));
+        for (size_t i = 0; i < xboxUserIdsCount; i++)
+        {
+            XblUserProfile& profile = request->Profiles[(int32)i];
+            profile.xboxUserId = xboxUserIds[i];
+            SetUserName(profile.gamertag, ARRAY_COUNT(profile.gamertag), profile.xboxUserId);
+            SetUserName(profile.modernGamertag, ARRAY_COUNT(profile.modernGamertag), profile.xboxUserId);
+        }
+        return BeginRequest(async, (const void*)ProfileGetUserProfilesAsync, request);
+    }
+
+    HRESULT ProfileGetUserProfilesResultCount(XAsyncBlock* async, size_t* profileCount)
+    {
+        size_t size = 0;
+        const HRESULT result = XAsyncGetResultSize(async, &size);
+        *profileCount = size / sizeof(XblUserProfile);
+        return result;
+    }
+
+    HRESULT ProfileGetUserProfilesResult(XAsyncBlock* async, size_t profilesCount, XblUserProfile* profiles)
+    {
+        return XAsyncGetResult(async, (const void*)ProfileGetUserProfilesAsync, profilesCount * sizeof(XblUserProfile), profiles, nullptr);
+    }
+
+    HRESULT LeaderboardGetLeaderboardAsync(XblContextHandle context, XblLeaderboardQuery query, XAsyncBlock* async)
+    {
+        auto request = New<Request>();
+        request->Type = Request::Types::Leaderboard;
+        request->StatName = query.statName ? query.statName : query.leaderboardName;
+        const int32 rowsCount = State.LeaderboardRows;
+        const int32 maxItems = query.maxItems != 0 ? (int32)query.maxItems : XBOX_LIVE_SIMULATED_PAGE_SIZE;
+        if (query.socialGroup != XblSocialGroupType::None)
+        {
+            // Friends of the user that are on the leaderboard (ordered by rank)
+            const int32 friendsStart = GetFriendsStart(GetXboxUserId(context));
+            for (int32 i = 0; i < State.Friends && friendsStart + i < rowsCount && request->Ranks.Count() < maxItems; i++)
+                request->Ranks.Add((uint32)(friendsStart + i + 1));
+        }
+        else
+        {
+            // Rows window starting at the requested user or after the skipped rows (local users are not on the leaderboard)
+            int32 start = (int32)query.skipResultToRank;
+            if (query.skipToXboxUserId != 0)
+                start = query.skipToXboxUserId >= XBOX_LIVE_SIMULATED_USER_XUID ? (int32)Math::Min<uint64>(GetUserIndex(query.skipToXboxUserId), rowsCount) : rowsCount;
+            for (int32 i = start; i < rowsCount && request->Ranks.Count() < maxItems; i++)
+                request->Ranks.Add((uint32)(i + 1));
+        }
+        return BeginRequest(async, (const void*)LeaderboardGetLeaderboardAsync, request);
+    }
+
+    HRESULT LeaderboardGetLeaderboardResultSize(XAsyncBlock* async, size_t* resultSizeInBytes)
+    {
+        return XAsyncGetResultSize(async, resultSizeInBytes);
+    }
+
+    HRESULT LeaderboardGetLeaderboardResult(XAsyncBlock* async, size_t bufferSize, void* buffer, XblLeaderboardResult** ptrToBuffer, size_t* bufferUsed)
+    {
+        const HRESULT result = XAsyncGetResult(async, (const void*)LeaderboardGetLeaderboardAsync, bufferSize, buffer, bufferUsed);
+        if (SUCCEEDED(result))
+            *ptrToBuffer = (XblLeaderboardResult*)buffer;
+        return result;
+    }
+
+    HRESULT GameSaveInitializeProviderAsync(XUserHandle user, const char* configurationId, bool syncOnDemand, XAsyncBlock* async)
+    {
+        auto request = New<Request>();
+        request->Type = Request::Types::SaveProvider;
+        request->Provider = New<SaveProvider>();
+        return BeginRequest(async, (const void*)GameSaveInitializeProviderAsync, request);
+    }
+
+    HRESULT GameSaveInitializeProviderResult(XAsyncBlock* async, XGameSaveProviderHandle* provider)
+    {
+        return XAsyncGetResult(async, (const void*)GameSaveInitializeProviderAsync, sizeof(XGameSaveProviderHandle), provider, nullptr);
+    }
+
+    void GameSaveCloseProvider(XGameSaveProviderHandle provider)
+    {
+        ScopeLock lock(State.Locker);
+        Delete((SaveProvider*)provider);
+    }
+
+    HRESULT GameSaveGetContainerInfo(XGameSaveProviderHandle provider, const char* containerName, void* context, XGameSaveContainerInfoCallback* callback)
+    {
+        ScopeLock lock(State.Locker);
+        const auto blobs = ((SaveProvider*)provider)->Containers.TryGet(StringAnsi(containerName));
+        if (blobs)
+        {
+            XGameSaveContainerInfo info = {};
+            info.name = containerName;
+            info.displayName = containerName;
+            info.blobCount = (uint32_t)blobs->Count();
+            for (const auto& e : *blobs)
+                info.totalSize += (uint64_t)e.Value.Count();
+            callback(&info, context);
+        }
+        return S_OK;
+    }
+
+    HRESULT GameSaveCreateContainer(XGameSaveProviderHandle provider, const char* containerName, XGameSaveContainerHandle* container)
+    {
+        auto result = New<SaveContainer>();
+        result->Provider = (SaveProvider*)provider;
+        result->Name = containerName;
+        *container = (XGameSaveContainerHandle)result;
+        return S_OK;
+    }
+
+    void GameSaveCloseContainer(XGameSaveContainerHandle container)
+    {
+        Delete((SaveContainer*)container);
+    }
+
+    HRESULT GameSaveEnumerateBlobInfo(XGameSaveContainerHandle container, void* context, XGameSaveBlobInfoCallback* callback)
+    {
+        ScopeLock lock(State.Locker);
+        const auto saveContainer = (SaveContainer*)container;
+        const auto blobs = saveContainer->Provider->Containers.TryGet(saveContainer->Name);
+        if (blobs)
+        {
+            for (const auto& e : *blobs)
+            {
+                XGameSaveBlobInfo info;
+                info.name = e.Key.Get();
+                info.size = (uint32_t)e.Value.Count();
+                if (!callback(&info, context))
+                    break;
+            }
+        }
+        return S_OK;
+    }
+
+    HRESULT GameSaveReadBlobData(XGameSaveContainerHandle container, const char** blobNames, uint32_t* countOfBlobs, size_t blobsSize, XGameSaveBlob* blobData)
+    {
+        ScopeLock lock(State.Locker);
+        const auto saveContainer = (SaveContainer*)container;
+        const auto blobs = saveContainer->Provider->Containers.TryGet(saveContainer->Name);
+        if (!blobs)
+            return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+
+        // Layout the blobs like the SDK does: blobs array, then name and data of each blob
+        const uint32_t count = *countOfBlobs;
+        byte* ptr = (byte*)(blobData + count);
+        const byte* end = (const byte*)blobData + blobsSize;
+        if (ptr > end)
+            return E_NOT_SUFFICIENT_BUFFER;
+        uint32_t found = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const StringAnsiView name(blobNames[i]);
+            const Array<byte>* data = blobs->TryGet(StringAnsi(name));
+            if (!data)
+                continue;
+            if (ptr + name.Length() + 1 + data->Count() > end)
+                return E_NOT_SUFFICIENT_BUFFER;
+            XGameSaveBlob& blob = blobData[found++];
+            blob.info.name = (char*)ptr;
+            Platform::MemoryCopy(ptr, name.Get(), name.Length());
+            ptr[name.Length()] = 0;
+            ptr += name.Length() + 1;
+            blob.info.size = (uint32_t)data->Count();
+            blob.data = ptr;
+            Platform::MemoryCopy(ptr, data->Get(), data->Count());
+            ptr += data->Count();
+        }
+        *countOfBlobs = found;
+        return S_OK;
+    }
+
+    HRESULT GameSaveCreateUpdate(XGameSaveContainerHandle container, const char* containerDisplayName, XGameSaveUpdateHandle* update)
+    {
+        auto result = New<SaveUpdate>();
+        result->Container = (SaveContainer*)container;
+        *update = (XGameSaveUpdateHandle)result;
+        return S_OK;
+    }
+
+    void GameSaveCloseUpdate(XGameSaveUpdateHandle update)
+    {
+        Delete((SaveUpdate*)update);
+    }
+
+    HRESULT GameSaveSubmitBlobWrite(XGameSaveUpdateHandle update, const char* blobName, const uint8_t* data, size_t byteCount)
+    {
+        ((SaveUpdate*)update)->Writes[StringAnsi(blobName)].Set(data, (int32)byteCount);
+        return S_OK;
+    }
+
+    HRESULT GameSaveSubmitBlobDelete(XGameSaveUpdateHandle update, const char* blobName)
+    {
+        ((SaveUpdate*)update)->Deletes.Add(StringAnsi(blobName));
+        return S_OK;
+    }
+
+    HRESULT GameSaveSubmitUpdate(XGameSaveUpdateHandle update)
+    {
+        ScopeLock lock(State.Locker);
+        const auto saveUpdate = (SaveUpdate*)update;
+        auto& blobs = saveUpdate->Container->Provider->Containers[saveUpdate->Container->Name];
+        for (const StringAnsi& name : saveUpdate->Deletes)
+            blobs.Remove(name);
+        for (const auto& e : saveUpdate->Writes)
+            blobs[e.Key] = e.Value;
+        return S_OK;
+    }
+}
+
+const XboxLiveService& XboxLiveSimulatedService::Begin(const XboxLiveReplayBenchmarkScenario& scenario)
+{
+    State.Latency = (uint32)(Math::Max(scenario.Latency, 0.0f) * 1000.0f);
+    State.Friends = Math::Max(scenario.Friends, 0);
+    State.LeaderboardRows = Math::Max(scenario.LeaderboardRows, 0);
+    Platform::AtomicStore(&State.Contexts, 0);
+    XboxLiveService& s = State.Service;
+    s.Initialize = Initialize;
+    s.CleanupAsync = CleanupAsync;
+    s.GetScid = GetScid;
+    s.UserGetLocalId = UserGetLocalId;
+    s.UserGetGamertag = UserGetGamertag;
+    s.UserRegisterForChangeEvent = UserRegisterForChangeEvent;
+    s.ContextCreateHandle = ContextCreateHandle;
+    s.ContextDuplicateHandle = ContextDuplicateHandle;
+    s.ContextCloseHandle = ContextCloseHandle;
+    s.ContextGetXboxUserId = ContextGetXboxUserId;
+    s.SocialGetSocialRelationshipsAsync = SocialGetSocialRelationshipsAsync;
+    s.SocialGetSocialRelationshipsResult = SocialGetSocialRelationshipsResult;
+    s.SocialRelationshipResultGetRelationships = SocialRelationshipResultGetRelationships;
+    s.SocialRelationshipResultHasNext = SocialRelationshipResultHasNext;
+    s.SocialRelationshipResultGetNextAsync = SocialRelationshipResultGetNextAsync;
+    s.SocialRelationshipResultGetNextResult = SocialRelationshipResultGetNextResult;
+    s.SocialRelationshipResultCloseHandle = SocialRelationshipResultCloseHandle;
+    s.ProfileGetUserProfilesAsync = ProfileGetUserProfilesAsync;
+    s.ProfileGetUserProfilesResultCount = ProfileGetUserProfilesResultCount;
+    s.ProfileGetUserProfilesResult = ProfileGetUserProfilesResult;
+    s.LeaderboardGetLeaderboardAsync = LeaderboardGetLeaderboardAsync;
+    s.LeaderboardGetLeaderboardResultSize = LeaderboardGetLeaderboardResultSize;
+    s.LeaderboardGetLeaderboardResult = LeaderboardGetLeaderboardResult;
+    s.GameSaveInitializeProviderAsync = GameSaveInitializeProviderAsync;
+    s.GameSaveInitializeProviderResult = GameSaveInitializeProviderResult;
+    s.GameSaveCloseProvider = GameSaveCloseProvider;
+    s.GameSaveGetContainerInfo = GameSaveGetContainerInfo;
+    s.GameSaveCreateContainer = GameSaveCreateContainer;
+    s.GameSaveCloseContainer = GameSaveCloseContainer;
+    s.GameSaveEnumerateBlobInfo = GameSaveEnumerateBlobInfo;
+    s.GameSaveReadBlobData = GameSaveReadBlobData;
+    s.GameSaveCreateUpdate = GameSaveCreateUpdate;
+    s.GameSaveCloseUpdate = GameSaveCloseUpdate;
+    s.GameSaveSubmitBlobWrite = GameSaveSubmitBlobWrite;
+    s.GameSaveSubmitBlobDelete = GameSaveSubmitBlobDelete;
+    s.GameSaveSubmitUpdate = GameSaveSubmitUpdate;
+    return s;
+}
+
+void XboxLiveSimulatedService::End()
+{
+    State.Service = XboxLiveService();
+    Platform::AtomicStore(&State.Contexts, 0);
+}
+
+User* XboxLiveSimulatedService::GetUser(int32 index)
+{
+    while (State.Users.Count() <= index)
+    {
+        const XUserLocalId localId = { XBOX_LIVE_SIMULATED_LOCAL_ID + (uint64)State.Users.Count() };
+        State.Users.Add(New<User>(nullptr, localId, String::Format(TEXT("BenchmarkLocalUser{0}"), State.Users.Count())));
+    }
+    return State.Users[index];
+}
+
+#endif
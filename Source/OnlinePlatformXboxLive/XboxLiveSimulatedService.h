@@ -0,0 +1,39 @@
+// Copyright (c) 2012-2022 Wojciech Figat. All rights reserved.
+
+#pragma once
+
+#if PLATFORM_GDK && !BUILD_RELEASE
+
+#include "Engine/Core/Types/BaseTypes.h"
+
+class User;
+struct XboxLiveService;
+struct XboxLiveReplayBenchmarkScenario;
+
+/// <summary>
+/// The simulated Xbox Live service for the OnlinePlatformXboxLive (see OnlinePlatformXboxLive::Service). Answers user contexts, friends, profiles, leaderboards and save games requests with the synthetic data of the benchmark scenario and completes them asynchronously after the scenario latency, so the whole plugin code (task queue, callbacks, caching, batching and retries) runs without Xbox Live. Not available in release builds.
+/// </summary>
+class XboxLiveSimulatedService
+{
+public:
+    /// <summary>
+    /// Starts the simulation of the scenario. Only a single simulation can be active at once.
+    /// </summary>
+    /// <param name="scenario">The scenario (friends count, leaderboard size and requests latency).</param>
+    /// <returns>The service functions.</returns>
+    static const XboxLiveService& Begin(const XboxLiveReplayBenchmarkScenario& scenario);
+
+    /// <summary>
+    /// Ends the simulation. Has to be called after the platform using the service was deinitialized.
+    /// </summary>
+    static void End();
+
+    /// <summary>
+    /// Gets the simulated local user. Users are created on the first use and kept until the engine exit (they don't have the system user handle). Users get Xbox user identifiers in the order of their login to the platform.
+    /// </summary>
+    /// <param name="index">The user index.</param>
+    /// <returns>The user.</returns>
+    static User* GetUser(int32 index);
+};
+
+#endif